@@ -22,16 +22,54 @@
 #include "AdcCommand.h"
 #include "ClientManager.h"
 
-AdcCommand::AdcCommand(uint32_t aCmd, char aType /* = TYPE_CLIENT */) : cmdInt(aCmd), from(0), type(aType) { }
-AdcCommand::AdcCommand(uint32_t aCmd, const uint32_t aTarget, char aType) : cmdInt(aCmd), from(0), to(aTarget), type(aType) { }
-AdcCommand::AdcCommand(Severity sev, Error err, const string& desc, char aType /* = TYPE_CLIENT */) : cmdInt(CMD_STA), from(0), type(aType) {
+AdcCommand::AdcCommand(uint32_t aCmd, char aType /* = TYPE_CLIENT */) : indexed(false), cmdInt(aCmd), from(0), type(aType) { }
+AdcCommand::AdcCommand(uint32_t aCmd, const uint32_t aTarget, char aType) : indexed(false), cmdInt(aCmd), from(0), to(aTarget), type(aType) { }
+AdcCommand::AdcCommand(Severity sev, Error err, const string& desc, char aType /* = TYPE_CLIENT */) : indexed(false), cmdInt(CMD_STA), from(0), type(aType) {
 	addParam(Util::toString(sev * 100 + err));
 	addParam(desc);
 }
-AdcCommand::AdcCommand(const string& aLine, bool nmdc /* = false */) throw(ParseException) : cmdInt(0), type(TYPE_CLIENT) {
+AdcCommand::AdcCommand(const string& aLine, bool nmdc /* = false */) throw(ParseException) : indexed(false), cmdInt(0), type(TYPE_CLIENT) {
 	parse(aLine, nmdc);
 }
 
+/**
+ * Find the end of the token starting at aStart. Escape-free tokens (the common case) are
+ * left in place and aOut is untouched; otherwise the unescaped token is stored in aOut.
+ * @return Pointer to the separating space or aEnd
+ */
+const char* AdcCommand::parseToken(const char* aStart, const char* aEnd, string& aOut, bool nmdc) const throw(ParseException) {
+	const char* p = aStart;
+	while(p != aEnd && *p != ' ' && *p != '\\')
+		++p;
+
+	if(p == aEnd || *p == ' ')
+		return p;
+
+	// Slow path, unescape the rest of the token
+	aOut.assign(aStart, p);
+	while(p != aEnd && *p != ' ') {
+		if(*p == '\\') {
+			++p;
+			if(p == aEnd)
+				throw ParseException("Escape at eol");
+			if(*p == 's')
+				aOut += ' ';
+			else if(*p == 'n')
+				aOut += '\n';
+			else if(*p == '\\')
+				aOut += '\\';
+			else if(*p == ' ' && nmdc)	// $ADCGET escaping, leftover from old specs
+				aOut += ' ';
+			else
+				throw ParseException("Unknown escape");
+		} else {
+			aOut += *p;
+		}
+		++p;
+	}
+	return p;
+}
+
 void AdcCommand::parse(const string& aLine, bool nmdc /* = false */) throw(ParseException) {
 	string::size_type i = 5;
 
@@ -62,86 +100,62 @@ void AdcCommand::parse(const string& aLine, bool nmdc /* = false */) throw(Parse
 		from = HUB_SID;
 	}
 
-	string::size_type len = aLine.length();
-	const char* buf = aLine.c_str();
-	string cur;
-	cur.reserve(128);
+	indexed = false;
+	parameters.clear();
+	if(i >= aLine.length()) {
+		i = aLine.length();
+	} else {
+		// Upper bound on the parameter count, saves reallocating the list for big INF's
+		parameters.reserve(std::count(aLine.begin() + i, aLine.end(), ' ') + 1);
+	}
+
+	const char* p = aLine.data() + i;
+	const char* end = aLine.data() + aLine.length();
+	string unescaped;
 
 	bool toSet = false;
 	bool featureSet = false;
 	bool fromSet = nmdc; // $ADCxxx never have a from CID...
 
-	while(i < len) {
-		switch(buf[i]) {
-		case '\\':
-			++i;
-			if(i == len)
-				throw ParseException("Escape at eol");
-			if(buf[i] == 's')
-				cur += ' ';
-			else if(buf[i] == 'n')
-				cur += '\n';
-			else if(buf[i] == '\\')
-				cur += '\\';
-			else if(buf[i] == ' ' && nmdc)	// $ADCGET escaping, leftover from old specs
-				cur += ' ';
-			else
-				throw ParseException("Unknown escape");
-			break;
-		case ' ':
-			// New parameter...
-			{
-				if((type == TYPE_BROADCAST || type == TYPE_DIRECT || type == TYPE_ECHO || type == TYPE_FEATURE) && !fromSet) {
-					if(cur.length() != 4) {
-						throw ParseException("Invalid SID length");
-					}
-					from = toSID(cur);
-					fromSet = true;
-				} else if((type == TYPE_DIRECT || type == TYPE_ECHO) && !toSet) {
-					if(cur.length() != 4) {
-						throw ParseException("Invalid SID length");
-					}
-					to = toSID(cur);
-					toSet = true;
-				} else if(type == TYPE_FEATURE && !featureSet) {
-					if(cur.length() % 5 != 0) {
-						throw ParseException("Invalid feature length");
-					}
-					// Skip...
-					featureSet = true;
-				} else {
-					parameters.push_back(cur);
-				}
-				cur.clear();
-			}
+	while(p < end) {
+		unescaped.clear();
+		const char* tokEnd = parseToken(p, end, unescaped, nmdc);
+		bool escaped = !unescaped.empty();
+		const char* tok = escaped ? unescaped.data() : p;
+		size_t tokLen = escaped ? unescaped.length() : (size_t)(tokEnd - p);
+
+		// The last token is only a parameter if it's not empty
+		if(tokEnd == end && tokLen == 0)
 			break;
-		default:
-			cur += buf[i];
-		}
-		++i;
-	}
-	if(!cur.empty()) {
+
 		if((type == TYPE_BROADCAST || type == TYPE_DIRECT || type == TYPE_ECHO || type == TYPE_FEATURE) && !fromSet) {
-			if(cur.length() != 4) {
+			if(tokLen != 4) {
 				throw ParseException("Invalid SID length");
 			}
-			from = toSID(cur);
+			from = *reinterpret_cast<const uint32_t*>(tok);
 			fromSet = true;
 		} else if((type == TYPE_DIRECT || type == TYPE_ECHO) && !toSet) {
-			if(cur.length() != 4) {
+			if(tokLen != 4) {
 				throw ParseException("Invalid SID length");
 			}
-			to = toSID(cur);
+			to = *reinterpret_cast<const uint32_t*>(tok);
 			toSet = true;
 		} else if(type == TYPE_FEATURE && !featureSet) {
-			if(cur.length() % 5 != 0) {
+			if(tokLen % 5 != 0) {
 				throw ParseException("Invalid feature length");
 			}
-            // Skip...
+			// Skip...
 			featureSet = true;
 		} else {
-			parameters.push_back(cur);
+			parameters.push_back(string());
+			if(escaped)
+				parameters.back().swap(unescaped);
+			else
+				parameters.back().assign(tok, tokLen);
 		}
+
+		// Skip the separator
+		p = tokEnd + 1;
 	}
 
 	if((type == TYPE_BROADCAST || type == TYPE_DIRECT || type == TYPE_ECHO || type == TYPE_FEATURE) && !fromSet) {
@@ -158,55 +172,107 @@ void AdcCommand::parse(const string& aLine, bool nmdc /* = false */) throw(Parse
 }
 
 string AdcCommand::toString(const CID& aCID) const {
-	return getHeaderString(aCID) + getParamString(false);
+	string tmp = getHeaderString(aCID);
+	for(StringIterC i = getParameters().begin(); i != getParameters().end(); ++i) {
+		tmp += ' ';
+		tmp += escape(*i, false);
+	}
+	tmp += '\n';
+	return tmp;
 }
 
 string AdcCommand::toString(uint32_t sid /* = 0 */, bool nmdc /* = false */) const {
-	return getHeaderString(sid, nmdc) + getParamString(nmdc);
+	string tmp;
+	appendTo(tmp, sid, nmdc);
+	return tmp;
 }
 
-string AdcCommand::escape(const string& str, bool old) {
-	string tmp = str;
-	string::size_type i = 0;
-	while( (i = tmp.find_first_of(" \n\\", i)) != string::npos) {
+void AdcCommand::appendTo(string& aOut, uint32_t sid, bool nmdc /* = false */) const {
+	serialize(aOut, sid, nmdc);
+}
+
+void AdcCommand::appendTo(vector<uint8_t>& aOut, uint32_t sid, bool nmdc /* = false */) const {
+	serialize(aOut, sid, nmdc);
+}
+
+namespace {
+
+template<class Buf>
+void appendRaw(Buf& aOut, const char* aStr, size_t aLen) {
+	aOut.insert(aOut.end(), aStr, aStr + aLen);
+}
+
+template<class Buf>
+void appendEscaped(Buf& aOut, const string& aStr, bool old) {
+	const char* p = aStr.data();
+	const char* end = p + aStr.length();
+	const char* run = p;
+	for(; p != end; ++p) {
+		if(*p != ' ' && *p != '\n' && *p != '\\')
+			continue;
+		appendRaw(aOut, run, p - run);
+		run = p + 1;
+		aOut.push_back('\\');
 		if(old) {
-			tmp.insert(i, "\\");
+			aOut.push_back(*p);
 		} else {
-			switch(tmp[i]) {
-				case ' ': tmp.replace(i, 1, "\\s"); break;
-				case '\n': tmp.replace(i, 1, "\\n"); break;
-				case '\\': tmp.replace(i, 1, "\\\\"); break;
+			switch(*p) {
+				case ' ': aOut.push_back('s'); break;
+				case '\n': aOut.push_back('n'); break;
+				case '\\': aOut.push_back('\\'); break;
 			}
 		}
-		i+=2;
 	}
-	return tmp;
+	appendRaw(aOut, run, end - run);
 }
 
-string AdcCommand::getHeaderString(uint32_t sid, bool nmdc) const {
-	string tmp;
+}
+
+template<class Buf>
+void AdcCommand::serialize(Buf& aOut, uint32_t sid, bool nmdc) const {
+	// Only size a fresh buffer; appending to a backlog is left to the geometric growth
+	if(aOut.empty()) {
+		size_t len = 16 + features.length();
+		for(StringIterC i = getParameters().begin(); i != getParameters().end(); ++i)
+			len += i->length() + 1;
+		aOut.reserve(len);
+	}
+
 	if(nmdc) {
-		tmp += "$ADC";
+		appendRaw(aOut, "$ADC", 4);
 	} else {
-		tmp += getType();
+		aOut.push_back(getType());
 	}
 
-	tmp += cmdChar;
+	appendRaw(aOut, cmdChar, 3);
 
 	if(type == TYPE_BROADCAST || type == TYPE_DIRECT || type == TYPE_ECHO || type == TYPE_FEATURE) {
-		tmp += ' ';
-		tmp += fromSID(sid);
+		aOut.push_back(' ');
+		appendRaw(aOut, reinterpret_cast<const char*>(&sid), sizeof(sid));
 	}
 
 	if(type == TYPE_DIRECT || type == TYPE_ECHO) {
-		tmp += ' ';
-		tmp += fromSID(to);
+		aOut.push_back(' ');
+		appendRaw(aOut, reinterpret_cast<const char*>(&to), sizeof(to));
 	}
 
 	if(type == TYPE_FEATURE) {
-		tmp += ' ';
-		tmp += features;
+		aOut.push_back(' ');
+		appendRaw(aOut, features.data(), features.length());
 	}
+
+	for(StringIterC i = getParameters().begin(); i != getParameters().end(); ++i) {
+		aOut.push_back(' ');
+		appendEscaped(aOut, *i, nmdc);
+	}
+
+	aOut.push_back(nmdc ? '|' : '\n');
+}
+
+string AdcCommand::escape(const string& str, bool old) {
+	string tmp;
+	tmp.reserve(str.length());
+	appendEscaped(tmp, str, old);
 	return tmp;
 }
 
@@ -221,38 +287,70 @@ string AdcCommand::getHeaderString(const CID& cid) const {
 	return tmp;
 }
 
-string AdcCommand::getParamString(bool nmdc) const {
-	string tmp;
-	for(StringIterC i = getParameters().begin(); i != getParameters().end(); ++i) {
-		tmp += ' ';
-		tmp += escape(*i, nmdc);
-	}
-	if(nmdc) {
-		tmp += '|';
-	} else {
-		tmp += '\n';
+void AdcCommand::buildIndex() const {
+	memset(index, 0, sizeof(index));
+	indexed = true;
+	if(getParameters().size() > INDEX_MAX_PARAMS)
+		return;
+
+	for(size_t i = 0; i < getParameters().size(); ++i) {
+		const string& p = getParameters()[i];
+		if(p.length() < 2)
+			continue;
+		uint16_t code = toCode(p.c_str());
+		size_t slot = indexSlot(code);
+		// Keep the first occurrence of each code
+		while(index[slot].pos != 0 && index[slot].code != code)
+			slot = (slot + 1) & (INDEX_SIZE - 1);
+		if(index[slot].pos == 0) {
+			index[slot].code = code;
+			index[slot].pos = static_cast<uint16_t>(i + 1);
+		}
 	}
-	return tmp;
 }
 
-bool AdcCommand::getParam(const char* name, size_t start, string& ret) const {
-	for(string::size_type i = start; i < getParameters().size(); ++i) {
-		if(toCode(name) == toCode(getParameters()[i].c_str())) {
-			ret = getParameters()[i].substr(2);
-			return true;
+size_t AdcCommand::findParam(uint16_t code, size_t start) const {
+	if(!indexed)
+		buildIndex();
+
+	if(getParameters().size() <= INDEX_MAX_PARAMS) {
+		size_t slot = indexSlot(code);
+		while(index[slot].pos != 0) {
+			if(index[slot].code == code) {
+				size_t pos = index[slot].pos - 1;
+				if(pos >= start)
+					return pos;
+				// First occurrence is before start, look for a later one
+				break;
+			}
+			slot = (slot + 1) & (INDEX_SIZE - 1);
 		}
+		if(index[slot].pos == 0)
+			return string::npos;
 	}
-	return false;
+
+	for(size_t i = start; i < getParameters().size(); ++i) {
+		const string& p = getParameters()[i];
+		if(p.length() >= 2 && toCode(p.c_str()) == code)
+			return i;
+	}
+	return string::npos;
+}
+
+bool AdcCommand::getParam(const char* name, size_t start, string& ret) const {
+	size_t i = findParam(toCode(name), start);
+	if(i == string::npos)
+		return false;
+	ret.assign(getParameters()[i], 2, string::npos);
+	return true;
 }
 
 bool AdcCommand::hasFlag(const char* name, size_t start) const {
-	for(string::size_type i = start; i < getParameters().size(); ++i) {
-		if(toCode(name) == toCode(getParameters()[i].c_str()) &&
-			getParameters()[i].size() == 3 &&
-			getParameters()[i][2] == '1')
-		{
+	uint16_t code = toCode(name);
+	for(size_t i = findParam(code, start); i != string::npos; i = findParam(code, i + 1)) {
+		const string& p = getParameters()[i];
+		if(p.size() == 3 && p[2] == '1')
 			return true;
-		}
 	}
 	return false;
 }
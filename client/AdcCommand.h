@@ -120,19 +120,27 @@ public:
 
 	AdcCommand& setFeatures(const string& feat) { features = feat; return *this; }
 
-	StringList& getParameters() { return parameters; }
+	/** The caller may modify the list, so the named parameter index is rebuilt on next lookup */
+	StringList& getParameters() { indexed = false; return parameters; }
 	const StringList& getParameters() const { return parameters; }
 
 	string toString(const CID& aCID) const;
 	string toString(uint32_t sid, bool nmdc = false) const;
+	/** Append the serialized command to aOut without building intermediate strings */
+	void appendTo(string& aOut, uint32_t sid, bool nmdc = false) const;
+	void appendTo(vector<uint8_t>& aOut, uint32_t sid, bool nmdc = false) const;
 
 	AdcCommand& addParam(const string& name, const string& value) {
-		parameters.push_back(name);
+		parameters.push_back(string());
+		parameters.back().reserve(name.length() + value.length());
+		parameters.back() += name;
 		parameters.back() += value;
+		indexed = false;
 		return *this;
 	}
 	AdcCommand& addParam(const string& str) {
 		parameters.push_back(str);
+		indexed = false;
 		return *this;
 	}
 	const string& getParam(size_t n) const {
@@ -153,10 +161,23 @@ public:
 	static uint32_t toSID(const string& aSID) { return *reinterpret_cast<const uint32_t*>(aSID.data()); }
 	static string fromSID(const uint32_t aSID) { return string(reinterpret_cast<const char*>(&aSID), sizeof(aSID)); }
 private:
+	/** Open addressed table mapping a two-letter code to its first parameter */
+	enum { INDEX_SIZE = 64, INDEX_MAX_PARAMS = INDEX_SIZE / 2 };
+	struct IndexEntry {
+		uint16_t code;
+		uint16_t pos;	// parameter index + 1, 0 = empty slot
+	};
+
+	template<class Buf> void serialize(Buf& aOut, uint32_t sid, bool nmdc) const;
+	const char* parseToken(const char* aStart, const char* aEnd, string& aOut, bool nmdc) const throw(ParseException);
+	void buildIndex() const;
+	size_t findParam(uint16_t code, size_t start) const;
+	static size_t indexSlot(uint16_t code) { return ((code * 0x9E37U) >> 8) & (INDEX_SIZE - 1); }
+
 	string getHeaderString(const CID& cid) const;
-	string getHeaderString(uint32_t sid, bool nmdc) const;
-	string getParamString(bool nmdc) const;
 	StringList parameters;
+	mutable IndexEntry index[INDEX_SIZE];
+	mutable bool indexed;
 	string features;
 	union {
 		char cmdChar[4];
@@ -44,7 +44,7 @@ AdcHub::AdcHub(const string& aHubURL, bool secure) : Client(aHubURL, '\n', secur
 }
 
 AdcHub::~AdcHub() throw() {
-	TimerManager::getInstance()->removeListener(this);
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	clearUsers();
 }
 
@@ -86,6 +86,8 @@ void AdcHub::putUser(const uint32_t aSID) {
 	if(aSID != AdcCommand::HUB_SID)
 		ClientManager::getInstance()->putOffline(ou);
 
+	// Listeners must have seen the user before it goes away
+	flushUpdated();
 	fire(ClientListener::UserRemoved(), this, *ou);
 	delete ou;
 }
@@ -96,6 +98,7 @@ void AdcHub::clearUsers() {
 		Lock l(cs);
 		users.swap(tmp);
 	}
+	pendingUpdates.clear();
 
 	for(SIDIter i = tmp.begin(); i != tmp.end(); ++i) {
 		if(i->first != AdcCommand::HUB_SID)
@@ -154,7 +157,7 @@ void AdcHub::handle(AdcCommand::INF, AdcCommand& c) throw() {
 		setHubIdentity(u->getIdentity());
 		fire(ClientListener::HubUpdated(), this);
 	} else {
-		fire(ClientListener::UserUpdated(), this, *u);
+		updated(*u);
 	}
 }
 
@@ -193,6 +196,9 @@ void AdcHub::handle(AdcCommand::MSG, AdcCommand& c) throw() {
 	if(!from)
 		return;
 
+	// Let listeners see the sender's latest INF before the message
+	flushUpdated();
+
 	string pmFrom;
 	if(c.getParam("PM", 1, pmFrom)) { // add PM<group-cid> as well
 		OnlineUser* to = findUser(c.getTo());
@@ -337,7 +343,7 @@ void AdcHub::sendUDP(const AdcCommand& cmd) throw() {
 			return;
 		}
 		ip = ou.getIdentity().getIp();
-		port = static_cast<uint16_t>(Util::toInt(ou.getIdentity().getUdpPort()));
+		port = ou.getIdentity().getUdpPortNumber();
 		command = cmd.toString(ou.getUser()->getCID());
 	}
 	try {
@@ -603,7 +609,8 @@ void AdcHub::send(const AdcCommand& cmd) {
 		return;
 	if(cmd.getType() == AdcCommand::TYPE_UDP)
 		sendUDP(cmd);
-	send(cmd.toString(sid));
+	updateActivity();
+	socket->write(cmd, sid, false);
 }
 
 void AdcHub::on(Second, uint32_t aTick) throw() {
@@ -28,13 +28,14 @@
 #include "Streams.h"
 #include "SSLSocket.h"
 #include "CryptoManager.h"
+#include "AdcCommand.h"
 
 // Polling is used for tasks...should be fixed...
 #define POLL_TIMEOUT 250
 
 BufferedSocket::BufferedSocket(char aSeparator) throw() :
 separator(aSeparator), mode(MODE_LINE), filterIn(NULL),
-dataBytes(0), rollback(0), failed(false), sock(0), disconnecting(false)
+dataBytes(0), rollback(0), failed(false), sendLeft(0), sock(0), disconnecting(false)
 {
 	Thread::safeInc(sockets);
 }
@@ -68,6 +69,9 @@ void BufferedSocket::setMode (Modes aMode, size_t aRollback) {
 			break;
 		case MODE_ZPIPE:
 			filterIn = new UnZFilter;
+			// Kept for the lifetime of the socket, hubs may send several compressed blocks
+			if(zbuf.size() < inbuf.size())
+				zbuf.resize(inbuf.size());
 			break;
 		case MODE_DATA:
 			break;
@@ -159,7 +163,20 @@ void BufferedSocket::threadRead() throw(SocketException) {
 	dcassert(sock);
 	if(!sock)
 		return;
-	int left = sock->read(&inbuf[0], (int)inbuf.size());
+
+	// Only file data is shaped; control lines and compressed hub traffic (MODE_ZPIPE) always get through
+	bool bulk = (mode == MODE_DATA);
+	int connRate = bulk ? SETTING(THROTTLE_DOWNLOAD_CONN) : 0;
+	int globalRate = bulk ? SETTING(THROTTLE_DOWNLOAD) : 0;
+	size_t readSize = Throttle::take(downThrottle, connRate, Throttle::down, globalRate, inbuf.size());
+	if(readSize == 0) {
+		// Leave the data in the kernel, the sender will be slowed down by tcp
+		Thread::sleep(Throttle::getWait(downThrottle, connRate, Throttle::down, globalRate));
+		return;
+	}
+
+	int left = sock->read(&inbuf[0], (int)readSize);
+	Throttle::giveBack(downThrottle, connRate, Throttle::down, globalRate, readSize - max(left, 0));
 	if(left == -1) {
 		// EWOULDBLOCK, no data received...
 		return;
@@ -168,28 +185,21 @@ void BufferedSocket::threadRead() throw(SocketException) {
 		throw SocketException(STRING(CONNECTION_CLOSED));
 	}
 	size_t used;
-	string::size_type pos = 0;
-	// always uncompressed data
-	string l;
 	int bufpos = 0, total = left;
 
 	while (left > 0) {
 		switch (mode) {
 			case MODE_ZPIPE:
 				if (filterIn != NULL){
-					const int BufSize = 1024;
-					// Special to autodetect nmdc connections...
-					string::size_type pos = 0;
-					AutoArray<uint8_t> buffer (BufSize);
-					size_t in;
-					l = line;
-					// decompress all input data and store in l.
+					// decompress all input data, handing out lines as they appear
 					while (left) {
-						in = BufSize;
+						size_t in = zbuf.size();
 						used = left;
-						bool ret = (*filterIn) ((void *)(&inbuf[0] + total - left), used, &buffer[0], in);
+						bool ret = (*filterIn) ((void *)(&inbuf[0] + total - left), used, &zbuf[0], in);
 						left -= used;
-						l.append ((const char *)&buffer[0], in);
+						// Lines after a mode change still came out of the stream, hand them all out
+						for(size_t n = 0; n < in; )
+							n += dispatchLines((const char*)&zbuf[0] + n, in - n);
 						// if the stream ends before the data runs out, keep remainder of data in inbuf
 						if (!ret) {
 							bufpos = total-left;
@@ -197,40 +207,24 @@ void BufferedSocket::threadRead() throw(SocketException) {
 							break;
 						}
 					}
-					// process all lines
-					while ((pos = l.find(separator)) != string::npos) {
-						fire(BufferedSocketListener::Line(), l.substr(0, pos));
-						l.erase (0, pos + 1 /* seperator char */);
-					}
-					// store remainder
-					line = l;
-
 					break;
 				}
 			case MODE_LINE:
 				// Special to autodetect nmdc connections...
 				if(separator == 0) {
-					if(inbuf[0] == '$') {
+					if(inbuf[bufpos] == '$') {
 						separator = '|';
 					} else {
 						separator = '\n';
 					}
 				}
-				l = line + string ((char*)&inbuf[bufpos], left);
-				while ((pos = l.find(separator)) != string::npos) {
-					fire(BufferedSocketListener::Line(), l.substr(0, pos));
-					l.erase (0, pos + 1 /* separator char */);
-					if (l.length() < (size_t)left) left = l.length();
-					if (mode != MODE_LINE) {
-						// we changed mode; remainder of l is invalid.
-						l.clear();
-						bufpos = total - left;
-						break;
-					}
+				{
+					// Lines are scanned in place; if a listener changes the mode the rest is
+					// handled by the next iteration
+					size_t n = dispatchLines((const char*)&inbuf[bufpos], left);
+					bufpos += n;
+					left -= n;
 				}
-				if (pos == string::npos)
-					left = 0;
-				line = l;
 				break;
 			case MODE_DATA:
 				while(left > 0) {
@@ -256,9 +250,39 @@ void BufferedSocket::threadRead() throw(SocketException) {
 		}
 	}
 
-	if(mode == MODE_LINE && line.size() > static_cast<size_t>(SETTING(MAX_COMMAND_LENGTH))) {
-		throw SocketException(STRING(COMMAND_TOO_LONG));
+	fire(BufferedSocketListener::ReadDone());
+}
+
+size_t BufferedSocket::dispatchLines(const char* aBuf, size_t aLen) throw(SocketException) {
+	Modes startMode = mode;
+	const char* p = aBuf;
+	const char* end = aBuf + aLen;
+	while(p < end) {
+		const char* sep = (const char*)memchr(p, separator, end - p);
+		if(sep == NULL) {
+			// Only the unterminated tail is kept, so that's where the limit applies
+			if(line.size() + (end - p) > static_cast<size_t>(SETTING(MAX_COMMAND_LENGTH))) {
+				throw SocketException(STRING(COMMAND_TOO_LONG));
+			}
+			line.append(p, end - p);
+			p = end;
+			break;
+		}
+
+		if(line.empty()) {
+			lineBuf.assign(p, sep - p);
+		} else {
+			line.append(p, sep - p);
+			lineBuf.swap(line);
+			line.clear();
+		}
+		p = sep + 1;
+
+		fire(BufferedSocketListener::Line(), lineBuf);
+		if(mode != startMode)
+			break;
 	}
+	return p - aBuf;
 }
 
 void BufferedSocket::threadSendFile(InputStream* file) throw(Exception) {
@@ -308,8 +332,19 @@ void BufferedSocket::threadSendFile(InputStream* file) throw(Exception) {
 		while(writePos < writeBuf.size()) {
 			if(disconnecting)
 				return;
-			size_t writeSize = min(sockSize / 2, writeBuf.size() - writePos);
+			int connRate = SETTING(THROTTLE_UPLOAD_CONN);
+			int globalRate = SETTING(THROTTLE_UPLOAD);
+			size_t writeSize = Throttle::take(upThrottle, connRate, Throttle::up, globalRate,
+				min(sockSize / 2, writeBuf.size() - writePos));
+			if(writeSize == 0) {
+				// Out of tokens, keep serving incoming commands while the buckets refill
+				if(sock->wait(Throttle::getWait(upThrottle, connRate, Throttle::up, globalRate), Socket::WAIT_READ) & Socket::WAIT_READ)
+					threadRead();
+				continue;
+			}
+
 			int written = sock->write(&writeBuf[writePos], writeSize);
+			Throttle::giveBack(upThrottle, connRate, Throttle::up, globalRate, writeSize - max(written, 0));
 			if(written > 0) {
 				writePos += written;
 
@@ -356,40 +391,62 @@ void BufferedSocket::write(const char* aBuf, size_t aLen) throw() {
 	writeBuf.insert(writeBuf.end(), aBuf, aBuf+aLen);
 }
 
-void BufferedSocket::threadSendData() {
+void BufferedSocket::write(const AdcCommand& aCmd, uint32_t aSid, bool nmdc) throw() {
 	dcassert(sock);
 	if(!sock)
 		return;
-	{
-		Lock l(cs);
-		if(writeBuf.empty())
-			return;
-
-		writeBuf.swap(sendBuf);
-	}
+	Lock l(cs);
+	if(writeBuf.empty())
+		addTask(SEND_DATA, 0);
 
-	size_t left = sendBuf.size();
-	size_t done = 0;
-	while(left > 0) {
-		if(disconnecting) {
-			return;
-		}
+	aCmd.appendTo(writeBuf, aSid, nmdc);
+}
 
-		int w = sock->wait(POLL_TIMEOUT, Socket::WAIT_READ | Socket::WAIT_WRITE);
+void BufferedSocket::threadSendData() {
+	dcassert(sock);
+	if(!sock)
+		return;
+	// Keep going until the queue is empty, writes made meanwhile go out in the same task
+	while(true) {
+		size_t left;
+		{
+			Lock l(cs);
+			if(writeBuf.empty())
+				return;
 
-		if(w & Socket::WAIT_READ) {
-			threadRead();
+			writeBuf.swap(sendBuf);
+			left = sendLeft = sendBuf.size();
 		}
 
-		if(w & Socket::WAIT_WRITE) {
+		size_t done = 0;
+		while(left > 0) {
+			if(disconnecting) {
+				return;
+			}
+
+			// Usually the kernel buffer has room, only poll when it's full
 			int n = sock->write(&sendBuf[done], left);
 			if(n > 0) {
 				left -= n;
 				done += n;
+				Lock l(cs);
+				sendLeft = left;
+				continue;
 			}
+
+			int w = sock->wait(POLL_TIMEOUT, Socket::WAIT_READ | Socket::WAIT_WRITE);
+
+			if(w & Socket::WAIT_READ) {
+				threadRead();
+			}
+		}
+		sendBuf.clear();
+
+		// A steady stream of writes mustn't keep incoming data waiting
+		if(sock->wait(0, Socket::WAIT_READ) & Socket::WAIT_READ) {
+			threadRead();
 		}
 	}
-	sendBuf.clear();
 }
 
 bool BufferedSocket::checkEvents() {
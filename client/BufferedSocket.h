@@ -29,7 +29,9 @@
 #include "Util.h"
 #include "ZUtils.h"
 #include "Socket.h"
+#include "Throttle.h"
 
+class AdcCommand;
 class InputStream;
 class Socket;
 class SocketException;
@@ -47,6 +49,7 @@ public:
 	typedef X<5> ModeChange;
 	typedef X<6> TransmitDone;
 	typedef X<7> Failed;
+	typedef X<8> ReadDone;
 
 	virtual void on(Connecting) throw() { }
 	virtual void on(Connected) throw() { }
@@ -56,6 +59,8 @@ public:
 	virtual void on(ModeChange) throw() { }
 	virtual void on(TransmitDone) throw() { }
 	virtual void on(Failed, const string&) throw() { }
+	/** All data from one socket read has been dispatched */
+	virtual void on(ReadDone) throw() { }
 };
 
 class BufferedSocket : public Speaker<BufferedSocketListener>, public Thread
@@ -107,6 +112,12 @@ public:
 
 	void write(const string& aData) throw() { write(aData.data(), aData.length()); }
 	void write(const char* aBuf, size_t aLen) throw();
+	/** Serialize aCmd straight into the output buffer */
+	void write(const AdcCommand& aCmd, uint32_t aSid, bool nmdc) throw();
+	/** @return Bytes accepted by write() that haven't reached the kernel yet */
+	size_t getQueuedBytes() throw() { Lock l(cs); return writeBuf.size() + sendLeft; }
+	/** Senders of optional traffic (search replies...) should back off when this is true */
+	bool isBacklogged() throw() { return getQueuedBytes() > MAX_QUEUED; }
 	/** Send the file f over this socket. */
 	void transmitFile(InputStream* f) throw() { Lock l(cs); addTask(SEND_FILE, new SendFileInfo(f)); }
 
@@ -116,6 +127,8 @@ public:
 
 	GETSET(char, separator, Separator)
 private:
+	enum { MAX_QUEUED = 256*1024 };
+
 	enum Tasks {
 		CONNECT,
 		DISCONNECT,
@@ -157,18 +170,34 @@ private:
 	int64_t dataBytes;
 	size_t rollback;
 	bool failed;
+	/** Unterminated tail of the input */
 	string line;
+	/** Reused for each complete line handed to listeners */
+	string lineBuf;
 	vector<uint8_t> inbuf;
+	/** Inflated MODE_ZPIPE data, sized like inbuf */
+	vector<uint8_t> zbuf;
 	vector<uint8_t> writeBuf;
 	vector<uint8_t> sendBuf;
+	/** Unsent part of sendBuf, guarded by cs */
+	size_t sendLeft;
 
 	Socket* sock;
 	bool disconnecting;
 
+	/** Per-connection limits, chained to Throttle::up and Throttle::down */
+	Throttle upThrottle;
+	Throttle downThrottle;
+
 	virtual int run();
 
 	void threadConnect(const string& aAddr, uint16_t aPort, bool proxy) throw(SocketException);
 	void threadRead() throw(SocketException);
+	/**
+	 * Fire Line for each separator-terminated line in aBuf, appending the rest to line.
+	 * @return Bytes consumed, less than aLen if a listener changed the mode
+	 */
+	size_t dispatchLines(const char* aBuf, size_t aLen) throw(SocketException);
 	void threadSendFile(InputStream* is) throw(Exception);
 	void threadSendData();
 	void threadDisconnect();
@@ -43,7 +43,7 @@ Client::Client(const string& hubURL, char separator_, bool secure_) :
 
 Client::~Client() throw() {
 	dcassert(!socket);
-	TimerManager::getInstance()->removeListener(this);
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	updateCounts(true);
 }
 
@@ -115,6 +115,26 @@ void Client::on(Connected) throw() {
 	fire(ClientListener::Connected(), this);
 }
 
+void Client::updated(const OnlineUser& aUser) {
+	OnlineUser* ou = const_cast<OnlineUser*>(&aUser);
+	if(!pendingUpdates.empty() && pendingUpdates.back() == ou)
+		return;
+
+	pendingUpdates.push_back(ou);
+	if(pendingUpdates.size() >= UPDATE_BATCH)
+		flushUpdated();
+}
+
+void Client::flushUpdated() {
+	if(pendingUpdates.empty())
+		return;
+
+	OnlineUser::List tmp;
+	tmp.reserve(UPDATE_BATCH);
+	pendingUpdates.swap(tmp);
+	fire(ClientListener::UsersUpdated(), this, tmp);
+}
+
 void Client::disconnect(bool graceLess) {
 	if(!socket)
 		return;
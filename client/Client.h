@@ -111,7 +111,12 @@ public:
 	string getIpPort() const { return getIp() + ':' + Util::toString(port); }
 	string getLocalIp() const;
 
-	void updated(const OnlineUser& aUser) { fire(ClientListener::UserUpdated(), this, aUser); }
+	/**
+	 * Queue aUser for the next UsersUpdated batch. Batches are fired when full and after each
+	 * socket read, so must only be called from the socket thread.
+	 */
+	void updated(const OnlineUser& aUser);
+	void flushUpdated();
 
 	static string getCounts() {
 		char buf[128];
@@ -137,6 +142,9 @@ public:
 		socket->write(aMessage, aLen);
 	}
 
+	/** @return True if the hub isn't keeping up with what we send, optional traffic should be skipped */
+	bool isBacklogged() { return socket && socket->isBacklogged(); }
+
 	string getMyNick() const { return getMyIdentity().getNick(); }
 	string getHubName() const { return getHubIdentity().getNick().empty() ? getHubUrl() : getHubIdentity().getNick(); }
 	string getHubDescription() const { return getHubIdentity().getDescription(); }
@@ -171,6 +179,10 @@ protected:
 
 	BufferedSocket* socket;
 
+	/** Max users announced per UsersUpdated */
+	enum { UPDATE_BATCH = 256 };
+	OnlineUser::List pendingUpdates;
+
 	static Counts counts;
 	Counts lastCounts;
 
@@ -208,7 +220,7 @@ private:
 	// BufferedSocketListener
 	virtual void on(Connecting) throw() { fire(ClientListener::Connecting(), this); }
 	virtual void on(Connected) throw();
-
+	virtual void on(ReadDone) throw() { flushUpdated(); }
 
 };
 
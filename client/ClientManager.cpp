@@ -303,10 +303,12 @@ void ClientManager::send(AdcCommand& cmd, const CID& cid) {
 		if(cmd.getType() == AdcCommand::TYPE_UDP && !u.getIdentity().isUdpActive()) {
 			cmd.setType(AdcCommand::TYPE_DIRECT);
 			cmd.setTo(u.getIdentity().getSID());
-			u.getClient().send(cmd);
+			// Only search results come this way, drop them rather than queue behind a slow hub
+			if(!u.getClient().isBacklogged())
+				u.getClient().send(cmd);
 		} else {
 			try {
-				udp.writeTo(u.getIdentity().getIp(), static_cast<uint16_t>(Util::toInt(u.getIdentity().getUdpPort())), cmd.toString(getMe()->getCID()));
+				udp.writeTo(u.getIdentity().getIp(), u.getIdentity().getUdpPortNumber(), cmd.toString(getMe()->getCID()));
 			} catch(const SocketException&) {
 				dcdebug("Socket exception sending ADC UDP command\n");
 			}
@@ -334,6 +336,10 @@ void ClientManager::on(NmdcSearch, Client* aClient, const string& aSeeker, int a
 	if(isPassive && !ClientManager::getInstance()->isActive()) {
 		return;
 	}
+	// ...or when the hub connection is already saturated
+	if(isPassive && aClient->isBacklogged()) {
+		return;
+	}
 
 	SearchResult::List l;
 	ShareManager::getInstance()->search(l, aString, aSearchType, aSize, aFileType, aClient, isPassive ? 5 : 10);
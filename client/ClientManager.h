@@ -131,7 +131,7 @@ private:
 
 	virtual ~ClientManager() throw() {
 		SettingsManager::getInstance()->removeListener(this);
-		TimerManager::getInstance()->removeListener(this);
+		TimerManager::getInstance()->removeListenerAndWait(this);
 	}
 
 	void updateCachedIp();
@@ -142,7 +142,10 @@ private:
 	// ClientListener
 	virtual void on(Connected, Client* c) throw() { fire(ClientManagerListener::ClientConnected(), c); }
 	virtual void on(UserUpdated, Client*, const OnlineUser& user) throw() { fire(ClientManagerListener::UserUpdated(), user); }
-	virtual void on(UsersUpdated, Client* c, const User::List&) throw() { fire(ClientManagerListener::ClientUpdated(), c); }
+	virtual void on(UsersUpdated, Client* c, const OnlineUser::List& l) throw() {
+		fire(ClientManagerListener::UsersUpdated(), l);
+		fire(ClientManagerListener::ClientUpdated(), c);
+	}
 	virtual void on(Failed, Client*, const string&) throw();
 	virtual void on(HubUpdated, Client* c) throw() { fire(ClientManagerListener::ClientUpdated(), c); }
 	virtual void on(UserCommand, Client*, int, int, const string&, const string&) throw();
@@ -35,6 +35,7 @@ public:
 	typedef X<4> ClientConnected;
 	typedef X<5> ClientUpdated;
 	typedef X<6> ClientDisconnected;
+	typedef X<7> UsersUpdated;
 
 	/** User online in at least one hub */
 	virtual void on(UserConnected, const User::Ptr&) throw() { }
@@ -45,6 +46,8 @@ public:
 	virtual void on(ClientConnected, Client*) throw() { }
 	virtual void on(ClientUpdated, Client*) throw() { }
 	virtual void on(ClientDisconnected, Client*) throw() { }
+	/** Several users of one hub updated at once */
+	virtual void on(UsersUpdated, const OnlineUser::List&) throw() { }
 };
 
 #endif // !defined(CLIENT_MANAGER_LISTENER_H)
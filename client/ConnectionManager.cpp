@@ -85,6 +85,7 @@ ConnectionQueueItem* ConnectionManager::getCQI(const User::Ptr& aUser, bool down
 	if(download) {
 		dcassert(find(downloads.begin(), downloads.end(), aUser) == downloads.end());
 		downloads.push_back(cqi);
+		scheduleCQI(cqi, 0);
 	} else {
 		dcassert(find(uploads.begin(), uploads.end(), aUser) == uploads.end());
 		uploads.push_back(cqi);
@@ -94,11 +95,22 @@ ConnectionQueueItem* ConnectionManager::getCQI(const User::Ptr& aUser, bool down
 	return cqi;
 }
 
+void ConnectionManager::scheduleCQI(ConnectionQueueItem* cqi, uint32_t aTick) {
+	unscheduleCQI(cqi);
+	cqi->setNextCheck(aTick);
+	schedule.insert(make_pair(aTick, cqi));
+}
+
+void ConnectionManager::unscheduleCQI(ConnectionQueueItem* cqi) {
+	schedule.erase(make_pair(cqi->getNextCheck(), cqi));
+}
+
 void ConnectionManager::putCQI(ConnectionQueueItem* cqi) {
 	fire(ConnectionManagerListener::Removed(), cqi);
 	if(cqi->getDownload()) {
 		dcassert(find(downloads.begin(), downloads.end(), cqi) != downloads.end());
 		downloads.erase(remove(downloads.begin(), downloads.end(), cqi), downloads.end());
+		unscheduleCQI(cqi);
 	} else {
 		dcassert(find(uploads.begin(), uploads.end(), cqi) != uploads.end());
 		uploads.erase(remove(uploads.begin(), uploads.end(), cqi), uploads.end());
@@ -126,71 +138,87 @@ void ConnectionManager::putConnection(UserConnection* aConn) {
 	userConnections.erase(remove(userConnections.begin(), userConnections.end(), aConn), userConnections.end());
 }
 
+static const uint32_t RETRY_DELAY = 60*1000;
+static const uint32_t CONNECT_TIMEOUT = 50*1000;
+/** Retries back off up to RETRY_DELAY << MAX_BACKOFF */
+static const int MAX_BACKOFF = 4;
+
+namespace {
+	typedef pair<ConnectionQueueItem*, User::Ptr> Candidate;
+	typedef pair<QueueItem::Priority, Candidate> RankedCandidate;
+
+	struct HigherPriority {
+		bool operator()(const RankedCandidate& a, const RankedCandidate& b) const { return a.first > b.first; }
+	};
+}
+
 void ConnectionManager::on(TimerManagerListener::Second, uint32_t aTick) throw() {
 	User::List passiveUsers;
 	ConnectionQueueItem::List removed;
 	User::List idlers;
+	vector<Candidate> due;
+	int attemptsLeft = max(SETTING(CONNECT_ATTEMPTS), 1);
 
 	{
 		Lock l(cs);
 
-		bool attemptDone = false;
-
 		idlers = checkIdle;
 		checkIdle.clear();
 
-		for(ConnectionQueueItem::Iter i = downloads.begin(); i != downloads.end(); ++i) {
-			ConnectionQueueItem* cqi = *i;
+		// Only items whose time has come are looked at; a few more than can be connected
+		// are taken so that the ones with the highest queue priority go first
+		for(Schedule::iterator i = schedule.begin(); i != schedule.end() && i->first <= aTick && due.size() < (size_t)attemptsLeft * 4; ) {
+			ConnectionQueueItem* cqi = (i++)->second;
+			dcassert(cqi->getState() != ConnectionQueueItem::ACTIVE);
 
-			if(cqi->getState() != ConnectionQueueItem::ACTIVE) {
-				if(!cqi->getUser()->isOnline()) {
-					// Not online anymore...remove it from the pending...
-					removed.push_back(cqi);
-					continue;
-				}
-
-				if(cqi->getUser()->isSet(User::PASSIVE) && !ClientManager::getInstance()->isActive()) {
-					passiveUsers.push_back(cqi->getUser());
-					removed.push_back(cqi);
-					continue;
-				}
-
-				if( ((cqi->getLastAttempt() + 60*1000) < aTick) && !attemptDone ) {
-					cqi->setLastAttempt(aTick);
-
-					QueueItem::Priority prio = QueueManager::getInstance()->hasDownload(cqi->getUser());
-
-					if(prio == QueueItem::PAUSED) {
-						removed.push_back(cqi);
-						continue;
-					}
-
-					bool startDown = DownloadManager::getInstance()->startDownload(prio);
-                    
-					if(cqi->getState() == ConnectionQueueItem::WAITING) {
-						if(startDown) {
-							cqi->setState(ConnectionQueueItem::CONNECTING);
-							ClientManager::getInstance()->connect(cqi->getUser());
-							fire(ConnectionManagerListener::StatusChanged(), cqi);
-							attemptDone = true;
-						} else {
-							cqi->setState(ConnectionQueueItem::NO_DOWNLOAD_SLOTS);
-							fire(ConnectionManagerListener::Failed(), cqi, STRING(ALL_DOWNLOAD_SLOTS_TAKEN));
-						}
-					} else if(cqi->getState() == ConnectionQueueItem::NO_DOWNLOAD_SLOTS && startDown) {
-						cqi->setState(ConnectionQueueItem::WAITING);
-					}
-				} else if(((cqi->getLastAttempt() + 50*1000) < aTick) && (cqi->getState() == ConnectionQueueItem::CONNECTING)) {
-					fire(ConnectionManagerListener::Failed(), cqi, STRING(CONNECTION_TIMEOUT));
-					cqi->setState(ConnectionQueueItem::WAITING);
-				}
+			if(!cqi->getUser()->isOnline()) {
+				// Not online anymore...remove it from the pending...
+				removed.push_back(cqi);
+				continue;
 			}
+
+			if(cqi->getUser()->isSet(User::PASSIVE) && !ClientManager::getInstance()->isActive()) {
+				passiveUsers.push_back(cqi->getUser());
+				removed.push_back(cqi);
+				continue;
+			}
+
+			if(cqi->getState() == ConnectionQueueItem::CONNECTING) {
+				fire(ConnectionManagerListener::Failed(), cqi, STRING(CONNECTION_TIMEOUT));
+				cqi->setState(ConnectionQueueItem::WAITING);
+				cqi->setErrors(min(cqi->getErrors() + 1, MAX_BACKOFF));
+				scheduleCQI(cqi, cqi->getLastAttempt() + (RETRY_DELAY << cqi->getErrors()));
+				continue;
+			}
+
+			due.push_back(make_pair(cqi, cqi->getUser()));
 		}
 
 		for(ConnectionQueueItem::Iter m = removed.begin(); m != removed.end(); ++m) {
 			putCQI(*m);
 		}
+	}
+
+	if(!due.empty()) {
+		// The queue lock is only needed for this part
+		vector<RankedCandidate> ranked;
+		ranked.reserve(due.size());
+		for(vector<Candidate>::iterator i = due.begin(); i != due.end(); ++i)
+			ranked.push_back(make_pair(QueueManager::getInstance()->hasDownload(i->second), *i));
+		stable_sort(ranked.begin(), ranked.end(), HigherPriority());
 
+		Lock l(cs);
+		for(vector<RankedCandidate>::iterator i = ranked.begin(); i != ranked.end(); ++i) {
+			ConnectionQueueItem* cqi = i->second.first;
+			// Might have been removed or connected while the lock was released
+			if(find(downloads.begin(), downloads.end(), cqi) == downloads.end() || cqi->getUser() != i->second.second ||
+				cqi->getState() == ConnectionQueueItem::ACTIVE || cqi->getState() == ConnectionQueueItem::CONNECTING)
+			{
+				continue;
+			}
+
+			attempt(cqi, i->first, aTick, attemptsLeft);
+		}
 	}
 
 	for(User::Iter i = idlers.begin(); i != idlers.end(); ++i) {
@@ -202,6 +230,38 @@ void ConnectionManager::on(TimerManagerListener::Second, uint32_t aTick) throw()
 	}
 }
 
+void ConnectionManager::attempt(ConnectionQueueItem* cqi, QueueItem::Priority prio, uint32_t aTick, int& attemptsLeft) {
+	if(prio == QueueItem::PAUSED) {
+		putCQI(cqi);
+		return;
+	}
+
+	bool startDown = DownloadManager::getInstance()->startDownload(prio);
+
+	if(!startDown) {
+		if(cqi->getState() == ConnectionQueueItem::WAITING) {
+			cqi->setState(ConnectionQueueItem::NO_DOWNLOAD_SLOTS);
+			fire(ConnectionManagerListener::Failed(), cqi, STRING(ALL_DOWNLOAD_SLOTS_TAKEN));
+		}
+		cqi->setLastAttempt(aTick);
+		scheduleCQI(cqi, aTick + RETRY_DELAY);
+		return;
+	}
+
+	cqi->setState(ConnectionQueueItem::WAITING);
+	if(attemptsLeft == 0) {
+		// Keeps its place in the schedule for the next second
+		return;
+	}
+
+	attemptsLeft--;
+	cqi->setLastAttempt(aTick);
+	cqi->setState(ConnectionQueueItem::CONNECTING);
+	scheduleCQI(cqi, aTick + CONNECT_TIMEOUT);
+	ClientManager::getInstance()->connect(cqi->getUser());
+	fire(ConnectionManagerListener::StatusChanged(), cqi);
+}
+
 void ConnectionManager::on(TimerManagerListener::Minute, uint32_t aTick) throw() {
 	Lock l(cs);
 
@@ -522,6 +582,8 @@ void ConnectionManager::addDownloadConnection(UserConnection* uc) {
 			ConnectionQueueItem* cqi = *i;
 			if(cqi->getState() == ConnectionQueueItem::WAITING || cqi->getState() == ConnectionQueueItem::CONNECTING) {
 				cqi->setState(ConnectionQueueItem::ACTIVE);
+				cqi->setErrors(0);
+				unscheduleCQI(cqi);
 				uc->setFlag(UserConnection::FLAG_ASSOCIATED);
 
 				fire(ConnectionManagerListener::Connected(), cqi);
@@ -627,6 +689,7 @@ void ConnectionManager::on(UserConnectionListener::Failed, UserConnection* aSour
 			ConnectionQueueItem* cqi = *i;
 			cqi->setState(ConnectionQueueItem::WAITING);
 			cqi->setLastAttempt(GET_TICK());
+			scheduleCQI(cqi, cqi->getLastAttempt() + RETRY_DELAY);
 			fire(ConnectionManagerListener::Failed(), cqi, aError);
 		} else if(aSource->isSet(UserConnection::FLAG_UPLOAD)) {
 			ConnectionQueueItem::Iter i = find(uploads.begin(), uploads.end(), aSource->getUser());
@@ -650,7 +713,7 @@ void ConnectionManager::disconnect(const User::Ptr& aUser, int isDownload) {
 }
 
 void ConnectionManager::shutdown() {
-	TimerManager::getInstance()->removeListener(this);
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	shuttingDown = true;
 	disconnect();
 	{
@@ -27,6 +27,7 @@
 
 #include "UserConnection.h"
 #include "User.h"
+#include "QueueItem.h"
 #include "CriticalSection.h"
 #include "Singleton.h"
 #include "Util.h"
@@ -48,13 +49,17 @@ public:
 		ACTIVE						// In one up/downmanager
 	};
 
-	ConnectionQueueItem(const User::Ptr& aUser, bool aDownload) : state(WAITING), lastAttempt(0), download(aDownload), user(aUser) { }
+	ConnectionQueueItem(const User::Ptr& aUser, bool aDownload) : state(WAITING), lastAttempt(0), nextCheck(0), errors(0), download(aDownload), user(aUser) { }
 
 	User::Ptr& getUser() { return user; }
 	const User::Ptr& getUser() const { return user; }
 
 	GETSET(State, state, State);
 	GETSET(uint32_t, lastAttempt, LastAttempt);
+	/** When the connection manager looks at this item again, if it's scheduled */
+	GETSET(uint32_t, nextCheck, NextCheck);
+	/** Connection attempts that timed out in a row, for backing off */
+	GETSET(int, errors, Errors);
 	GETSET(bool, download, Download);
 private:
 	ConnectionQueueItem(const ConnectionQueueItem&);
@@ -142,6 +147,10 @@ private:
 	ConnectionQueueItem::List downloads;
 	ConnectionQueueItem::List uploads;
 
+	typedef set<pair<uint32_t, ConnectionQueueItem*> > Schedule;
+	/** Download items that aren't active, ordered by the time they need attention */
+	Schedule schedule;
+
 	/** All active connections */
 	UserConnection::List userConnections;
 
@@ -173,6 +182,10 @@ private:
 	ConnectionQueueItem* getCQI(const User::Ptr& aUser, bool download);
 	void putCQI(ConnectionQueueItem* cqi);
 
+	void scheduleCQI(ConnectionQueueItem* cqi, uint32_t aTick);
+	void unscheduleCQI(ConnectionQueueItem* cqi);
+	void attempt(ConnectionQueueItem* cqi, QueueItem::Priority prio, uint32_t aTick, int& attemptsLeft);
+
 	void accept(const Socket& sock, bool secure) throw();
 
 	// UserConnectionListener
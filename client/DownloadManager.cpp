@@ -31,6 +31,7 @@
 #include "File.h"
 #include "FilteredFile.h"
 #include "MerkleCheckOutputStream.h"
+#include "ThreadedOutputStream.h"
 
 #include <limits>
 
@@ -43,13 +44,13 @@ static const string DOWNLOAD_AREA = "Downloads";
 const string Download::ANTI_FRAG_EXT = ".antifrag";
 
 Download::Download(UserConnection& conn) throw() : Transfer(conn), file(0),
-crcCalc(NULL), treeValid(false) {
+crcCalc(NULL), treeCheck(NULL), verifiedBytes(0), treeValid(false) {
 	conn.setDownload(this);
 }
 
 Download::Download(UserConnection& conn, QueueItem& qi) throw() : Transfer(conn),
 	target(qi.getTarget()), tempTarget(qi.getTempTarget()), file(0),
-	crcCalc(NULL), treeValid(false) 
+	crcCalc(NULL), treeCheck(NULL), verifiedBytes(qi.isSet(QueueItem::FLAG_RESUME) ? qi.getVerifiedBytes() : 0), treeValid(false) 
 {
 	conn.setDownload(this);
 	
@@ -99,7 +100,7 @@ DownloadManager::DownloadManager() {
 }
 
 DownloadManager::~DownloadManager() throw() {
-	TimerManager::getInstance()->removeListener(this);
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	while(true) {
 		{
 			Lock l(cs);
@@ -130,22 +131,41 @@ void DownloadManager::on(TimerManagerListener::Second, uint32_t aTick) throw() {
 
 
 		// Automatically remove or disconnect slow sources
-		if((uint32_t)(aTick / 1000) % SETTING(AUTODROP_INTERVAL) == 0) {
+		uint32_t interval = SETTING(AUTODROP_INTERVAL);
+		if(interval > 0 && (uint32_t)(aTick / 1000) % interval == 0) {
+			// The settings are read once for all the downloads
+			uint32_t now = GET_TICK();
+			uint32_t minElapsed = (uint32_t)SETTING(AUTODROP_ELAPSED) * 1000;
+			uint32_t maxInactive = (uint32_t)SETTING(AUTODROP_INACTIVITY) * 1000;
+			uint32_t minSpeed = (uint32_t)SETTING(AUTODROP_SPEED);
+			int minSources = SETTING(AUTODROP_MINSOURCES);
+			int64_t minSize = ((int64_t)SETTING(AUTODROP_FILESIZE)) * 1024;
+			bool dropLists = BOOLSETTING(AUTODROP_FILELISTS);
+			bool dropAll = BOOLSETTING(AUTODROP_ALL);
+			bool disconnect = BOOLSETTING(AUTODROP_DISCONNECT);
+
 			for(Download::Iter i = downloads.begin(); i != downloads.end(); ++i) {
-				uint32_t timeElapsed = GET_TICK() - (*i)->getStart();
-				uint32_t timeInactive = GET_TICK() - (*i)->getUserConnection().getLastActivity();
+				uint32_t timeElapsed = now - (*i)->getStart();
+				uint32_t timeInactive = now - (*i)->getUserConnection().getLastActivity();
 				uint64_t bytesDownloaded = (*i)->getTotal();
-				bool timeElapsedOk = timeElapsed >= (uint32_t)SETTING(AUTODROP_ELAPSED) * 1000;
-				bool timeInactiveOk = timeInactive <= (uint32_t)SETTING(AUTODROP_INACTIVITY) * 1000;
+				bool timeElapsedOk = timeElapsed >= minElapsed;
+				bool timeInactiveOk = timeInactive <= maxInactive;
 				bool speedTooLow = timeElapsedOk && timeInactiveOk && bytesDownloaded > 0 ?
-					bytesDownloaded / timeElapsed * 1000 < (uint32_t)SETTING(AUTODROP_SPEED) : false;
+					bytesDownloaded / timeElapsed * 1000 < minSpeed : false;
+				if(!speedTooLow)
+					continue;
+
+				bool filesizeOk = !((*i)->isSet(Download::FLAG_USER_LIST)) && (*i)->getSize() >= minSize;
+				bool dropIt = ((*i)->isSet(Download::FLAG_USER_LIST) && dropLists) ||
+					(filesizeOk && dropAll);
+				if(!dropIt)
+					continue;
+
+				// Counting the sources takes the queue lock, so it's checked last
 				bool onlineSourcesOk = (*i)->isSet(Download::FLAG_USER_LIST) ?
-					true : QueueManager::getInstance()->countOnlineSources((*i)->getTarget()) >= SETTING(AUTODROP_MINSOURCES);
-				bool filesizeOk = !((*i)->isSet(Download::FLAG_USER_LIST)) && (*i)->getSize() >= ((int64_t)SETTING(AUTODROP_FILESIZE)) * 1024;
-				bool dropIt = ((*i)->isSet(Download::FLAG_USER_LIST) && BOOLSETTING(AUTODROP_FILELISTS)) ||
-					(filesizeOk && BOOLSETTING(AUTODROP_ALL));
-				if(speedTooLow && onlineSourcesOk && dropIt) {
-					if(BOOLSETTING(AUTODROP_DISCONNECT) && !((*i)->isSet(Download::FLAG_USER_LIST))) {
+					true : QueueManager::getInstance()->countOnlineSources((*i)->getTarget()) >= minSources;
+				if(onlineSourcesOk) {
+					if(disconnect && !((*i)->isSet(Download::FLAG_USER_LIST))) {
 						(*i)->getUserConnection().disconnect();
 					} else {
 						dropTargets.push_back(make_pair((*i)->getTarget(), (*i)->getUser()));
@@ -326,7 +346,9 @@ void DownloadManager::checkDownloads(UserConnection* aConn) {
 		   (d->getTigerTree().getLeaves().size() > 32 || // 32 leaves is 5 levels
 		    d->getTigerTree().getBlockSize() * 10 < d->getSize()))
 		{
-			d->setStartPos(getResumePos(d->getDownloadTarget(), d->getTigerTree(), start));
+			d->setStartPos(getResumePos(d->getDownloadTarget(), d->getTigerTree(), start, d->getVerifiedBytes()));
+			// Everything before the resume position has now been checked against the tree
+			d->setVerifiedBytes(d->getStartPos());
 		} else {
 			int rollback = SETTING(ROLLBACK);
 			if(rollback > start) {
@@ -363,44 +385,41 @@ public:
 	virtual size_t flush() throw(Exception) { return 0; }
 };
 
-int64_t DownloadManager::getResumePos(const string& file, const TigerTree& tt, int64_t startPos) {
+int64_t DownloadManager::getResumePos(const string& file, const TigerTree& tt, int64_t startPos, int64_t verified) {
 	// Always discard data until the last block
 	if(startPos < tt.getBlockSize())
 		return 0;
 
 	startPos -= (startPos % tt.getBlockSize());
 
-	DummyOutputStream dummy;
+	// Whatever was checked while downloading doesn't need to be read again
+	int64_t pos = verified - (verified % tt.getBlockSize());
+	if(pos >= startPos)
+		return startPos;
 
+	// Only the data written without a check (crash, older queue file...) is hashed, in one
+	// forward pass; the first bad leaf ends the good part of the file
+	DummyOutputStream dummy;
 	vector<uint8_t> buf((size_t)min((int64_t)1024*1024, tt.getBlockSize()));
+	MerkleCheckOutputStream<TigerTree, false> check(tt, &dummy, pos);
 
-	do {
-		int64_t blockPos = startPos - tt.getBlockSize();
-
-		try {
-			MerkleCheckOutputStream<TigerTree, false> check(tt, &dummy, blockPos);
-
-			File inFile(file, File::READ, File::OPEN);
-			inFile.setPos(blockPos);
-			int64_t bytesLeft = tt.getBlockSize();
-			while(bytesLeft > 0) {
-				size_t n = (size_t)min((int64_t)buf.size(), bytesLeft);
-				size_t nr = inFile.read(&buf[0], n);
-				check.write(&buf[0], nr);
-				bytesLeft -= nr;
-				if(bytesLeft > 0 && nr == 0) {
-					// Huh??
-					throw Exception();
-				}
-			}
-			check.flush();
-			break;
-		} catch(const Exception&) {
-			dcdebug("Removed bad block at %ld\n", blockPos);
+	try {
+		File inFile(file, File::READ, File::OPEN);
+		inFile.setPos(pos);
+		int64_t bytesLeft = startPos - pos;
+		while(bytesLeft > 0) {
+			size_t n = (size_t)min((int64_t)buf.size(), bytesLeft);
+			size_t nr = inFile.read(&buf[0], n);
+			if(nr == 0)
+				break;
+			check.write(&buf[0], nr);
+			bytesLeft -= nr;
 		}
-		startPos = blockPos;
-	} while(startPos > 0);
-	return startPos;
+	} catch(const Exception&) {
+		dcdebug("Bad block after %ld\n", check.verifiedBytes());
+	}
+
+	return max(pos, min(startPos, check.verifiedBytes()));
 }
 
 void DownloadManager::on(UserConnectionListener::Sending, UserConnection* aSource, int64_t aBytes) throw() {
@@ -563,10 +582,21 @@ bool DownloadManager::prepareFile(UserConnection* aSource, int64_t newSize, bool
 		/** @todo check the rest of the file when resuming? */
 		if(d->getTreeValid()) {
 			if((d->getPos() % d->getTigerTree().getBlockSize()) == 0) {
-				d->setFile(new MerkleCheckOutputStream<TigerTree, true>(d->getTigerTree(), d->getFile(), d->getPos()));
+				Download::TreeOS* check = new Download::TreeOS(d->getTigerTree(), d->getFile(), d->getPos());
+				d->setTreeCheck(check);
+				d->setFile(check);
 				d->setFlag(Download::FLAG_TTH_CHECK);
 			}
 		}
+
+		// Leaf hashing, crc and disk writes move off the socket thread so they don't stall the
+		// receive window; the rollback check stays here since it needs to fail the source right away
+		try {
+			d->setFile(new ThreadedOutputStream<true>(d->getFile(), MAX_QUEUED_DATA));
+		} catch(const ThreadException&) {
+			dcdebug("DownloadManager: Writing synchronously, no thread\n");
+		}
+
 		if(d->isSet(Download::FLAG_ROLLBACK)) {
 			d->setFile(new RollbackOutputStream<true>(file, d->getFile(), (size_t)min((int64_t)SETTING(ROLLBACK), d->getSize() - d->getPos())));
 		}
@@ -658,6 +688,7 @@ void DownloadManager::handleEndData(UserConnection* aSource) {
 			delete d->getFile();
 			d->setFile(NULL);
 			d->setCrcCalc(NULL);
+			d->setTreeCheck(NULL);
 
 			// Check if we're anti-fragging...
 			if(d->isSet(Download::FLAG_ANTI_FRAG)) {
@@ -826,15 +857,23 @@ void DownloadManager::failDownload(UserConnection* aSource, const string& reason
 
 void DownloadManager::removeDownload(Download* d) {
 	if(d->getFile()) {
+		bool flushed = true;
 		if(d->getActual() > 0) {
 			try {
 				d->getFile()->flush();
 			} catch(const Exception&) {
+				flushed = false;
 			}
 		}
+		// Remembered by the queue so the next resume needn't rehash this part. The tree
+		// check counts leaves before they're written, so only trust what reached the file,
+		// and it counts the leaves before its start, which must have been verified already.
+		if(flushed && d->getTreeCheck() != NULL && d->getStartPos() <= d->getVerifiedBytes())
+			d->setVerifiedBytes(max(d->getVerifiedBytes(), min(d->getTreeCheck()->verifiedBytes(), d->getPos())));
 		delete d->getFile();
 		d->setFile(NULL);
 		d->setCrcCalc(NULL);
+		d->setTreeCheck(NULL);
 
 		if(d->isSet(Download::FLAG_ANTI_FRAG)) {
 			d->unsetFlag(Download::FLAG_ANTI_FRAG);
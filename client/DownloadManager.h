@@ -33,6 +33,7 @@
 #include "QueueItem.h"
 
 class ConnectionQueueItem;
+template<class TreeType, bool managed> class MerkleCheckOutputStream;
 
 /**
  * Comes as an argument in the DownloadManagerListener functions.
@@ -85,11 +86,15 @@ public:
 	AdcCommand getCommand(bool zlib);
 
 	typedef CalcOutputStream<CRC32Filter, true> CrcOS;
+	typedef MerkleCheckOutputStream<TigerTree, true> TreeOS;
 	GETSET(string, source, Source);
 	GETSET(string, target, Target);
 	GETSET(string, tempTarget, TempTarget);
 	GETSET(OutputStream*, file, File);
 	GETSET(CrcOS*, crcCalc, CrcCalc);
+	GETSET(TreeOS*, treeCheck, TreeCheck);
+	/** Bytes from the start of the target known to match the tree */
+	GETSET(int64_t, verifiedBytes, VerifiedBytes);
 	GETSET(bool, treeValid, TreeValid);
 
 private:
@@ -177,6 +182,8 @@ public:
 	bool startDownload(QueueItem::Priority prio);
 private:
 	enum { MOVER_LIMIT = 10*1024*1024 };
+	/** Received data that may be waiting for the disk / hashing thread of a download */
+	enum { MAX_QUEUED_DATA = 4*1024*1024 };
 	class FileMover : public Thread {
 	public:
 		FileMover() : active(false) { }
@@ -209,7 +216,7 @@ private:
 	void logDownload(UserConnection* aSource, Download* d);
 	uint32_t calcCrc32(const string& file) throw(FileException);
 	bool checkSfv(UserConnection* aSource, Download* d, uint32_t crc);
-	int64_t getResumePos(const string& file, const TigerTree& tt, int64_t startPos);
+	int64_t getResumePos(const string& file, const TigerTree& tt, int64_t startPos, int64_t verified);
 
 	void failDownload(UserConnection* aSource, const string& reason);
 
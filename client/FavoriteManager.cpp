@@ -662,6 +662,19 @@ void FavoriteManager::on(TypeBZ2, HttpConnection*) throw() {
 void FavoriteManager::on(UserUpdated, const OnlineUser& user) throw() {
 	userUpdated(user);
 }
+void FavoriteManager::on(UsersUpdated, const OnlineUser::List& list) throw() {
+	Lock l(cs);
+	bool changed = false;
+	for(OnlineUser::List::const_iterator j = list.begin(); j != list.end(); ++j) {
+		FavoriteMap::iterator i = users.find((*j)->getUser()->getCID());
+		if(i != users.end()) {
+			i->second.update(**j);
+			changed = true;
+		}
+	}
+	if(changed)
+		save();
+}
 void FavoriteManager::on(UserDisconnected, const User::Ptr& user) throw() {
 	bool isFav = false;
 	{
@@ -255,6 +255,7 @@ private:
 
 	// ClientManagerListener
 	virtual void on(UserUpdated, const OnlineUser& user) throw();
+	virtual void on(UsersUpdated, const OnlineUser::List& list) throw();
 	virtual void on(UserConnected, const User::Ptr& user) throw();
 	virtual void on(UserDisconnected, const User::Ptr& user) throw();
 
@@ -122,6 +122,17 @@ size_t File::read(void* buf, size_t& len) throw(FileException) {
 	return x;
 }
 
+size_t File::readAt(void* buf, size_t len, int64_t pos) throw(FileException) {
+	OVERLAPPED o = { 0 };
+	o.Offset = (DWORD)(pos & 0xffffffff);
+	o.OffsetHigh = (DWORD)(pos >> 32);
+	DWORD x;
+	if(!::ReadFile(h, buf, (DWORD)len, &x, &o) && GetLastError() != ERROR_HANDLE_EOF) {
+		throw(FileException(Util::translateError(GetLastError())));
+	}
+	return x;
+}
+
 size_t File::write(const void* buf, size_t len) throw(FileException) {
 	DWORD x;
 	if(!::WriteFile(h, buf, (DWORD)len, &x, NULL)) {
@@ -276,6 +287,13 @@ size_t File::read(void* buf, size_t& len) throw(FileException) {
 	return (size_t)x;
 }
 
+size_t File::readAt(void* buf, size_t len, int64_t pos) throw(FileException) {
+	ssize_t x = ::pread(h, buf, len, (off_t)pos);
+	if(x == -1)
+		throw FileException("Read error");
+	return (size_t)x;
+}
+
 size_t File::write(const void* buf, size_t len) throw(FileException) {
 	ssize_t x = ::write(h, buf, len);
 	if(x == -1)
@@ -91,6 +91,10 @@ public:
 	virtual size_t write(const void* buf, size_t len) throw(FileException);
 	virtual size_t flush() throw(FileException);
 
+	// Read at an absolute position; concurrent readAt calls are safe. On Windows this
+	// moves the file pointer, so writes to the same File must be serialized with it.
+	size_t readAt(void* buf, size_t len, int64_t pos) throw(FileException);
+
 	uint32_t getLastModified() throw();
 
 	static void copyFile(const string& src, const string& target) throw(FileException);
@@ -55,8 +55,48 @@ TTHValue HashManager::getTTH(const string& aFileName, int64_t aSize) throw(HashE
 }
 
 bool HashManager::getTree(const TTHValue& root, TigerTree& tt) {
-	Lock l(cs);
-	return store.getTree(root, tt);
+	if(treeCache.get(root, tt))
+		return true;
+
+	{
+		Lock l(cs);
+		if(!store.getTree(root, tt))
+			return false;
+	}
+
+	treeCache.put(tt);
+	return true;
+}
+
+bool HashManager::TreeCache::get(const TTHValue& root, TigerTree& tt) {
+	FastLock l(cs);
+	TreeMap::iterator i = index.find(root);
+	if(i == index.end())
+		return false;
+
+	trees.splice(trees.begin(), trees, i->second);
+	tt = trees.front();
+	return true;
+}
+
+void HashManager::TreeCache::put(const TigerTree& tt) {
+	size_t n = getBytes(tt);
+	if(n > TREE_CACHE_SIZE / 4)
+		return;
+
+	FastLock l(cs);
+	if(index.find(tt.getRoot()) != index.end())
+		return;
+
+	while(!trees.empty() && bytes + n > TREE_CACHE_SIZE) {
+		bytes -= getBytes(trees.back());
+		index.erase(trees.back().getRoot());
+		trees.pop_back();
+	}
+
+	trees.push_front(tt);
+	index.insert(make_pair(tt.getRoot(), trees.begin()));
+	bytes += n;
 }
 
 void HashManager::hashDone(const string& aFileName, uint32_t aTimeStamp, const TigerTree& tth, int64_t speed) {
@@ -106,7 +146,7 @@ void HashManager::HashStore::addTree(const TigerTree& tt) throw() {
 		try {
 			File f(getDataFile(), File::READ|File::WRITE, File::OPEN);
 			int64_t index = saveTree(f, tt);
-			treeIndex.insert(make_pair(tt.getRoot(), TreeInfo(tt.getFileSize(), index, tt.getBlockSize())));
+			treeIndex.insert(make_pair(tt.getRoot(), TreeInfo(tt.getFileSize(), index, tt.getBlockSize(), true)));
 			dirty = true;
 		} catch(const FileException& e) {
 			LogManager::getInstance()->message(STRING(ERROR_SAVING_HASH) + e.getError());
@@ -139,19 +179,24 @@ int64_t HashManager::HashStore::saveTree(File& f, const TigerTree& tt) throw(Fil
 	return pos;
 }
 
-bool HashManager::HashStore::loadTree(File& f, const TreeInfo& ti, const TTHValue& root, TigerTree& tt) {
+bool HashManager::HashStore::loadTree(File& f, TreeInfo& ti, const TTHValue& root, TigerTree& tt) {
 	if(ti.getIndex() == SMALL_TREE) {
 		tt = TigerTree(ti.getSize(), ti.getBlockSize(), root);
 		return true;
 	}
 	try {
-		f.setPos(ti.getIndex());
 		size_t datalen = TigerTree::calcBlocks(ti.getSize(), ti.getBlockSize()) * TTHValue::SIZE;
 		AutoArray<uint8_t> buf(datalen);
-		f.read((uint8_t*)buf, datalen);
-		tt = TigerTree(ti.getSize(), ti.getBlockSize(), buf);
-		if(!(tt.getRoot() == root))
+		if(f.readAt((uint8_t*)buf, datalen, ti.getIndex()) != datalen)
 			return false;
+		if(ti.getVerified()) {
+			tt = TigerTree(ti.getSize(), ti.getBlockSize(), buf, root);
+		} else {
+			tt = TigerTree(ti.getSize(), ti.getBlockSize(), buf);
+			if(!(tt.getRoot() == root))
+				return false;
+			ti.setVerified(true);
+		}
 	} catch(const Exception&) {
 		return false;
 	}
@@ -164,8 +209,9 @@ bool HashManager::HashStore::getTree(const TTHValue& root, TigerTree& tt) {
 	if(i == treeIndex.end())
 		return false;
 	try {
-		File f(getDataFile(), File::READ, File::OPEN);
-		return loadTree(f, i->second, root, tt);
+		if(dataFile == NULL)
+			dataFile = new File(getDataFile(), File::READ, File::OPEN);
+		return loadTree(*dataFile, i->second, root, tt);
 	} catch(const Exception&) {
 		return false;
 	}
@@ -256,6 +302,10 @@ void HashManager::HashStore::rebuild() {
 				newFileIndex.erase(fi);
 		}
 
+		// Reopened on the next lookup
+		delete dataFile;
+		dataFile = NULL;
+
 		File::deleteFile(origName);
 		File::renameFile(tmpName, origName);
 		treeIndex = newTreeIndex;
@@ -411,7 +461,7 @@ void HashLoader::endTag(const string& name, const string&) {
 	}
 }
 
-HashManager::HashStore::HashStore() : dirty(false)
+HashManager::HashStore::HashStore() : dataFile(NULL), dirty(false)
 {
 	if(File::getSize(getDataFile()) <= static_cast<int64_t>(sizeof(int64_t))) {
 		try {
@@ -422,6 +472,10 @@ HashManager::HashStore::HashStore() : dirty(false)
 	}
 }
 
+HashManager::HashStore::~HashStore() {
+	delete dataFile;
+}
+
 /**
  * Creates the data files for storing hash values.
  * The data file is very simple in its format. The first 8 bytes
@@ -528,9 +582,10 @@ bool HashManager::Hasher::fastHash(const string& fname, uint8_t* buf, TigerTree&
 		if(size > 0) {
 			// Start a new overlapped read
 			ResetEvent(over.hEvent);
-			if(SETTING(MAX_HASH_SPEED) > 0) {
+			int maxSpeed = SETTING(MAX_HASH_SPEED);
+			if(maxSpeed > 0) {
 				uint32_t now = GET_TICK();
-				uint32_t minTime = hn * 1000LL / (SETTING(MAX_HASH_SPEED) * 1024LL * 1024LL);
+				uint32_t minTime = hn * 1000LL / (maxSpeed * 1024LL * 1024LL);
 				if(lastRead + minTime > now) {
 					uint32_t diff = now - lastRead;
 					Thread::sleep(minTime - diff);
@@ -611,9 +666,10 @@ bool HashManager::Hasher::fastHash(const string& filename, u_int8_t* , TigerTree
 
 			madvise(buf, size_read, MADV_SEQUENTIAL | MADV_WILLNEED);
 
-			if(SETTING(MAX_HASH_SPEED) > 0) {
+			int maxSpeed = SETTING(MAX_HASH_SPEED);
+			if(maxSpeed > 0) {
 				u_int32_t now = GET_TICK();
-				u_int32_t minTime = size_read * 1000LL / (SETTING(MAX_HASH_SPEED) * 1024LL * 1024LL);
+				u_int32_t minTime = size_read * 1000LL / (maxSpeed * 1024LL * 1024LL);
 				if(lastRead + minTime > now) {
 					u_int32_t diff = now - lastRead;
 					Thread::sleep(minTime - diff);
@@ -721,9 +777,11 @@ int HashManager::Hasher::run() {
 
 					do {
 						size_t bufSize = BUF_SIZE;
-						if(SETTING(MAX_HASH_SPEED) > 0) {
+						// Read once, the setting may change to 0 between two reads
+						int maxSpeed = SETTING(MAX_HASH_SPEED);
+						if(maxSpeed > 0) {
 							uint32_t now = GET_TICK();
-							uint32_t minTime = n * 1000LL / (SETTING(MAX_HASH_SPEED) * 1024LL * 1024LL);
+							uint32_t minTime = n * 1000LL / (maxSpeed * 1024LL * 1024LL);
 							if(lastRead + minTime > now) {
 								Thread::sleep(minTime - (now - lastRead));
 							}
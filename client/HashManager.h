@@ -63,7 +63,7 @@ public:
 		TimerManager::getInstance()->addListener(this);
 	}
 	virtual ~HashManager() throw() {
-		TimerManager::getInstance()->removeListener(this);
+		TimerManager::getInstance()->removeListenerAndWait(this);
 		hasher.join();
 	}
 
@@ -137,9 +137,31 @@ private:
 
 	friend class Hasher;
 
+	/** Recently used trees, so that popular files don't hit the hash store for every TTHL request */
+	class TreeCache {
+	public:
+		TreeCache() : bytes(0) { }
+
+		bool get(const TTHValue& root, TigerTree& tt);
+		void put(const TigerTree& tt);
+	private:
+		typedef list<TigerTree> TreeList;
+		typedef HASH_MAP_X(TTHValue, TreeList::iterator, TTHValue::Hash, equal_to<TTHValue>, less<TTHValue>) TreeMap;
+
+		/** Most recently used first */
+		TreeList trees;
+		TreeMap index;
+		size_t bytes;
+
+		FastCriticalSection cs;
+
+		static size_t getBytes(const TigerTree& tt) { return sizeof(TigerTree) + tt.getLeaves().size() * TTHValue::SIZE; }
+	};
+
 	class HashStore {
 	public:
 		HashStore();
+		~HashStore();
 		void addFile(const string& aFileName, uint32_t aTimeStamp, const TigerTree& tth, bool aUsed);
 
 		void load();
@@ -156,14 +178,16 @@ private:
 	private:
 		/** Root -> tree mapping info, we assume there's only one tree for each root (a collision would mean we've broken tiger...) */
 		struct TreeInfo {
-			TreeInfo() : size(0), index(0), blockSize(0) { }
-			TreeInfo(int64_t aSize, int64_t aIndex, int64_t aBlockSize) : size(aSize), index(aIndex), blockSize(aBlockSize) { }
-			TreeInfo(const TreeInfo& rhs) : size(rhs.size), index(rhs.index), blockSize(rhs.blockSize) { }
-			TreeInfo& operator=(const TreeInfo& rhs) { size = rhs.size; index = rhs.index; blockSize = rhs.blockSize; return *this; }
+			TreeInfo() : size(0), index(0), blockSize(0), verified(false) { }
+			TreeInfo(int64_t aSize, int64_t aIndex, int64_t aBlockSize, bool aVerified = false) : size(aSize), index(aIndex), blockSize(aBlockSize), verified(aVerified) { }
+			TreeInfo(const TreeInfo& rhs) : size(rhs.size), index(rhs.index), blockSize(rhs.blockSize), verified(rhs.verified) { }
+			TreeInfo& operator=(const TreeInfo& rhs) { size = rhs.size; index = rhs.index; blockSize = rhs.blockSize; verified = rhs.verified; return *this; }
 
 			GETSET(int64_t, size, Size);
 			GETSET(int64_t, index, Index);
 			GETSET(int64_t, blockSize, BlockSize);
+			/** The leaves at index are known to hash to the root (not saved, only for this session) */
+			GETSET(bool, verified, Verified);
 		};
 
 		/** File -> root mapping info */
@@ -194,11 +218,14 @@ private:
 		DirMap fileIndex;
 		TreeMap treeIndex;
 
+		/** Kept open for tree lookups, only read with File::readAt */
+		File* dataFile;
+
 		bool dirty;
 
 		void createDataFile(const string& name);
 
-		bool loadTree(File& dataFile, const TreeInfo& ti, const TTHValue& root, TigerTree& tt);
+		bool loadTree(File& dataFile, TreeInfo& ti, const TTHValue& root, TigerTree& tt);
 		int64_t saveTree(File& dataFile, const TigerTree& tt) throw(FileException);
 
 		string getIndexFile() { return Util::getConfigPath() + "HashIndex.xml"; }
@@ -209,11 +236,14 @@ private:
 
 	Hasher hasher;
 	HashStore store;
+	TreeCache treeCache;
 
 	CriticalSection cs;
 
 	/** Single node tree where node = root, no storage in HashData.dat */
 	static const int64_t SMALL_TREE = -1;
+	/** Upper bound for the memory used by treeCache */
+	static const size_t TREE_CACHE_SIZE = 8*1024*1024;
 
 	void hashDone(const string& aFileName, uint32_t aTimeStamp, const TigerTree& tth, int64_t speed);
 	void doRebuild() {
@@ -20,3 +20,112 @@
 #include "DCPlusPlus.h"
 
 #include "LogManager.h"
+
+LogManager::~LogManager() throw() {
+	{
+		Lock l(queueCs);
+		stop = true;
+	}
+	queued.signal();
+
+	// The writer writes what's in the queue before it quits
+	join();
+}
+
+void LogManager::log(const string& path, const string& msg) throw() {
+	for(;;) {
+		{
+			Lock l(queueCs);
+			if(queue.size() < MAX_QUEUED) {
+				if(queue.empty())
+					queued.signal();
+				queue.push_back(make_pair(path, msg + "\r\n"));
+				return;
+			}
+		}
+		// The disk can't keep up, give the writer some time
+		Thread::sleep(10);
+	}
+}
+
+int LogManager::run() {
+	setThreadPriority(Thread::LOW);
+
+	bool quit = false;
+	while(!quit) {
+		// Wake up now and then to close the idle files
+		queued.wait(FILE_TIMEOUT);
+
+		Queue lines;
+		{
+			Lock l(queueCs);
+			lines.swap(queue);
+			quit = stop;
+		}
+
+		uint32_t tick = GET_TICK();
+		write(lines, tick);
+		closeFiles(tick, quit ? 0 : FILE_TIMEOUT);
+	}
+	return 0;
+}
+
+void LogManager::write(Queue& lines, uint32_t tick) {
+	// One write per file for the lines of the batch
+	typedef HASH_MAP<string, string> Batch;
+	Batch batch;
+	for(Queue::iterator i = lines.begin(); i != lines.end(); ++i) {
+		batch[i->first] += i->second;
+	}
+
+	for(Batch::iterator i = batch.begin(); i != batch.end(); ++i) {
+		try {
+			File* f = getFile(i->first, tick);
+			f->write(i->second);
+		} catch(const FileException&) {
+			// Reopen the file next time
+			FileMap::iterator j = files.find(i->first);
+			if(j != files.end()) {
+				delete j->second.first;
+				files.erase(j);
+			}
+		}
+	}
+}
+
+File* LogManager::getFile(const string& path, uint32_t tick) {
+	FileMap::iterator i = files.find(path);
+	if(i != files.end()) {
+		i->second.second = tick;
+		return i->second.first;
+	}
+
+	if(files.size() >= MAX_OPEN_FILES) {
+		// Close the file that has waited the longest
+		FileMap::iterator oldest = files.begin();
+		for(FileMap::iterator j = files.begin(); j != files.end(); ++j) {
+			if(tick - j->second.second > tick - oldest->second.second)
+				oldest = j;
+		}
+		delete oldest->second.first;
+		files.erase(oldest);
+	}
+
+	string aPath = Util::validateFileName(path);
+	File::ensureDirectory(aPath);
+	File* f = new File(aPath, File::WRITE, File::OPEN | File::CREATE);
+	f->setEndPos(0);
+	files[path] = make_pair(f, tick);
+	return f;
+}
+
+void LogManager::closeFiles(uint32_t tick, uint32_t idle) {
+	for(FileMap::iterator i = files.begin(); i != files.end(); ) {
+		if(tick - i->second.second >= idle) {
+			delete i->second.first;
+			files.erase(i++);
+		} else {
+			++i;
+		}
+	}
+}
@@ -25,6 +25,8 @@
 
 #include "File.h"
 #include "CriticalSection.h"
+#include "Semaphore.h"
+#include "Thread.h"
 #include "Singleton.h"
 #include "TimerManager.h"
 
@@ -37,7 +39,12 @@ public:
 	virtual void on(Message, time_t, const string&) throw() { }
 };
 
-class LogManager : public Singleton<LogManager>, public Speaker<LogManagerListener>
+/**
+ * Log lines are queued and written by a thread of the manager, so the threads
+ * logging chat and transfers don't wait for the disk. The files stay open
+ * between writes.
+ */
+class LogManager : public Singleton<LogManager>, public Speaker<LogManagerListener>, private Thread
 {
 public:
 	enum LogArea { CHAT, PM, DOWNLOAD, UPLOAD, SYSTEM, STATUS, LAST };
@@ -81,18 +88,28 @@ public:
 	}
 
 private:
-	void log(const string& area, const string& msg) throw() {
-		Lock l(cs);
-		try {
-			string aArea = Util::validateFileName(area);
-			File::ensureDirectory(aArea);
-			File f(aArea, File::WRITE, File::OPEN | File::CREATE);
-			f.setEndPos(0);
-			f.write(msg + "\r\n");
-		} catch (const FileException&) {
-			// ...
-		}
-	}
+	enum {
+		/** Lines queued before log() has to wait for the writer */
+		MAX_QUEUED = 4096,
+		MAX_OPEN_FILES = 32,
+		/** A file not written to for this long is closed, so that files whose name has changed (dates in the name) don't stay open */
+		FILE_TIMEOUT = 60*1000
+	};
+
+	/** Queue a line to the file at path. */
+	void log(const string& path, const string& msg) throw();
+
+	virtual int run();
+
+	/** Path and the line to add */
+	typedef deque<pair<string, string> > Queue;
+	void write(Queue& lines, uint32_t tick);
+
+	/** An open log file and when it was last written to */
+	typedef HASH_MAP<string, pair<File*, uint32_t> > FileMap;
+	File* getFile(const string& path, uint32_t tick);
+	/** Close the files not written to in idle milliseconds */
+	void closeFiles(uint32_t tick, uint32_t idle);
 
 	friend class Singleton<LogManager>;
 	CriticalSection cs;
@@ -100,7 +117,17 @@ private:
 
 	int logOptions[LAST][2];
 
-	LogManager() {
+	/** Lines waiting for the writer, guarded by queueCs like stop */
+	Queue queue;
+	bool stop;
+	CriticalSection queueCs;
+	/** Signaled when the queue gets a line after being empty */
+	Semaphore queued;
+
+	/** Used by the writer thread only */
+	FileMap files;
+
+	LogManager() : stop(false) {
 		logOptions[UPLOAD][FILE]		= SettingsManager::LOG_FILE_UPLOAD;
 		logOptions[UPLOAD][FORMAT]		= SettingsManager::LOG_FORMAT_POST_UPLOAD;
 		logOptions[DOWNLOAD][FILE]		= SettingsManager::LOG_FILE_DOWNLOAD;
@@ -113,8 +140,10 @@ private:
 		logOptions[SYSTEM][FORMAT]		= SettingsManager::LOG_FORMAT_SYSTEM;
 		logOptions[STATUS][FILE]		= SettingsManager::LOG_FILE_STATUS;
 		logOptions[STATUS][FORMAT]		= SettingsManager::LOG_FORMAT_STATUS;
+
+		start();
 	}
-	virtual ~LogManager() throw() { }
+	virtual ~LogManager() throw();
 
 };
 
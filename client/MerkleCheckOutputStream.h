@@ -92,8 +92,9 @@ public:
 		return s->write(b, len);
 	}
 
-	int64_t verifiedBytes() {
-		return min(real.getFileSize(), (int64_t)(cur.getBlockSize() * cur.getLeaves().size()));
+	/** @return Bytes from the start of the file that matched the tree */
+	int64_t verifiedBytes() const {
+		return min(real.getFileSize(), (int64_t)(cur.getBlockSize() * verified));
 	}
 private:
 	OutputStream* s;
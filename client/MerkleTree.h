@@ -46,26 +46,33 @@ public:
 	typedef vector<MerkleValue> MerkleList;
 	typedef typename MerkleList::iterator MerkleIter;
 
-	MerkleTree() : fileSize(0), blockSize(baseBlockSize) { }
-	MerkleTree(int64_t aBlockSize) : fileSize(0), blockSize(aBlockSize) { }
+	MerkleTree() : peakLeaves(0), fileSize(0), blockSize(baseBlockSize) { }
+	MerkleTree(int64_t aBlockSize) : peakLeaves(0), fileSize(0), blockSize(aBlockSize) { }
 
 	/**
 	 * Loads a set of leaf hashes, calculating the root
 	 * @param data Pointer to (aFileSize + aBlockSize - 1) / aBlockSize) hash values,
 	 *             stored consecutively left to right
 	 */
-	MerkleTree(int64_t aFileSize, int64_t aBlockSize, uint8_t* aData) :
-		fileSize(aFileSize), blockSize(aBlockSize)
+	MerkleTree(int64_t aFileSize, int64_t aBlockSize, const uint8_t* aData) :
+		peakLeaves(0), fileSize(aFileSize), blockSize(aBlockSize)
 	{
-		size_t n = calcBlocks(aFileSize, aBlockSize);
-		for(size_t i = 0; i < n; i++)
-			leaves.push_back(MerkleValue(aData + i * Hasher::HASH_SIZE));
-
+		setLeafData(aData);
 		calcRoot();
 	}
 
+	/**
+	 * Loads a set of leaf hashes whose root is already known to match them,
+	 * skipping the root calculation.
+	 */
+	MerkleTree(int64_t aFileSize, int64_t aBlockSize, const uint8_t* aData, const MerkleValue& aRoot) :
+		root(aRoot), peakLeaves(0), fileSize(aFileSize), blockSize(aBlockSize)
+	{
+		setLeafData(aData);
+	}
+
 	/** Initialise a single root tree */
-	MerkleTree(int64_t aFileSize, int64_t aBlockSize, const MerkleValue& aRoot) : root(aRoot), fileSize(aFileSize), blockSize(aBlockSize) {
+	MerkleTree(int64_t aFileSize, int64_t aBlockSize, const MerkleValue& aRoot) : root(aRoot), peakLeaves(0), fileSize(aFileSize), blockSize(aBlockSize) {
 		leaves.push_back(root);
 	}
 
@@ -144,15 +151,41 @@ public:
 		return memcmp(aRoot, getRoot().data(), HASH_SIZE) == 0;
 	}
 
+	/**
+	 * Calculate the root from the leaves. Only leaves appended since the last call
+	 * are hashed; the leaves before them must not have been changed in between.
+	 */
 	void calcRoot() {
-		root = getHash(0, fileSize);
+		size_t n = min(leaves.size(), calcBlocks(fileSize, blockSize));
+		dcassert(n > 0);
+		if(n < peakLeaves) {
+			peaks.clear();
+			peakLeaves = 0;
+		}
+
+		for(; peakLeaves < n; ++peakLeaves) {
+			peaks.push_back(make_pair(leaves[peakLeaves], 1));
+			while(peaks.size() > 1 && peaks[peaks.size()-2].second == peaks.back().second) {
+				MerkleBlock& a = peaks[peaks.size()-2];
+				a.first = combine(a.first, peaks.back().first);
+				a.second *= 2;
+				peaks.pop_back();
+			}
+		}
+
+		if(peaks.empty())
+			return;
+
+		// The uneven right edge is folded into the subtrees to its left
+		root = peaks.back().first;
+		for(size_t i = peaks.size() - 1; i > 0; --i)
+			root = combine(peaks[i-1].first, root);
 	}
 
 	vector<uint8_t> getLeafData() {
 		vector<uint8_t> buf(getLeaves().size() * HASH_SIZE);
-		uint8_t* p = &buf[0];
 		for(size_t i = 0; i < getLeaves().size(); ++i) {
-			memcpy(p + i * HASH_SIZE, &getLeaves()[i], HASH_SIZE);
+			memcpy(&buf[i * HASH_SIZE], getLeaves()[i].data, HASH_SIZE);
 		}
 		return buf;
 	}
@@ -166,22 +199,18 @@ private:
 	MerkleList leaves;
 
 	MerkleValue root;
+	/** Roots of the complete subtrees over the first peakLeaves leaves, largest first */
+	MBList peaks;
+	size_t peakLeaves;
 	/** Total size of hashed data */
 	int64_t fileSize;
 	/** Final block size */
 	int64_t blockSize;
 
-	MerkleValue getHash(int64_t start, int64_t length) {
-		dcassert((start % blockSize) == 0);
-		if(length <= blockSize) {
-			dcassert((start / blockSize) < (int64_t)leaves.size());
-			return leaves[(uint32_t)(start / blockSize)];
-		} else {
-			int64_t l = blockSize;
-			while(l * 2 < length)
-				l *= 2;
-			return combine(getHash(start, l), getHash(start+l, length - l));
-		}
+	void setLeafData(const uint8_t* aData) {
+		leaves.resize(calcBlocks(fileSize, blockSize));
+		for(size_t i = 0; i < leaves.size(); ++i)
+			memcpy(leaves[i].data, aData + i * HASH_SIZE, HASH_SIZE);
 	}
 
 	MerkleValue combine(const MerkleValue& a, const MerkleValue& b) {
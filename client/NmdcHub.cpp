@@ -38,6 +38,7 @@ NmdcHub::NmdcHub(const string& aHubURL) : Client(aHubURL, '|', false), supportFl
 }
 
 NmdcHub::~NmdcHub() throw() {
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	clearUsers();
 }
 
@@ -138,6 +139,7 @@ void NmdcHub::clearUsers() {
 		Lock l(cs);
 		u2.swap(users);
 	}
+	pendingUpdates.clear();
 
 	for(NickIter i = u2.begin(); i != u2.end(); ++i) {
 		ClientManager::getInstance()->putOffline(i->second);
@@ -146,37 +148,177 @@ void NmdcHub::clearUsers() {
 }
 
 void NmdcHub::updateFromTag(Identity& id, const string& tag) {
-	StringTokenizer<string> tok(tag, ',');
-	for(StringIter i = tok.getTokens().begin(); i != tok.getTokens().end(); ++i) {
-		if(i->length() < 2)
-			continue;
-
-		if(i->compare(0, 2, "H:") == 0) {
-			StringTokenizer<string> t(i->substr(2), '/');
-			if(t.getTokens().size() != 3)
-				continue;
-			id.set("HN", t.getTokens()[0]);
-			id.set("HR", t.getTokens()[1]);
-			id.set("HO", t.getTokens()[2]);
-		} else if(i->compare(0, 2, "S:") == 0) {
-			id.set("SL", i->substr(2));
-		} else if(i->find("V:") != string::npos) {
-			string::size_type j = i->find("V:");
-			i->erase(i->begin() + j, i->begin() + j + 2);
-			id.set("VE", *i);
-		} else if(i->compare(0, 2, "M:") == 0) {
-			if(i->size() == 3) {
-				if((*i)[2] == 'A')
-					id.getUser()->unsetFlag(User::PASSIVE);
-				else
-					id.getUser()->setFlag(User::PASSIVE);
+	// Walk the comma separated fields in place instead of tokenizing into copies
+	string::size_type i = 0;
+	while(i < tag.length()) {
+		string::size_type j = tag.find(',', i);
+		if(j == string::npos)
+			j = tag.length();
+
+		if(j - i >= 2) {
+			const char* f = tag.data() + i;
+			string::size_type v;
+			if(f[0] == 'H' && f[1] == ':') {
+				string::size_type k = tag.find('/', i + 2);
+				string::size_type l = (k < j) ? tag.find('/', k + 1) : string::npos;
+				if(l < j && tag.find('/', l + 1) >= j) {
+					id.set("HN", tag.substr(i + 2, k - i - 2));
+					id.set("HR", tag.substr(k + 1, l - k - 1));
+					id.set("HO", tag.substr(l + 1, j - l - 1));
+				}
+			} else if(f[0] == 'S' && f[1] == ':') {
+				id.set("SL", tag.substr(i + 2, j - i - 2));
+			} else if((v = tag.find("V:", i)) != string::npos && v + 2 <= j) {
+				string ve = tag.substr(i, v - i);
+				ve.append(tag, v + 2, j - v - 2);
+				id.set("VE", ve);
+			} else if(f[0] == 'M' && f[1] == ':') {
+				if(j - i == 3) {
+					if(f[2] == 'A')
+						id.getUser()->unsetFlag(User::PASSIVE);
+					else
+						id.getUser()->setFlag(User::PASSIVE);
+				}
 			}
 		}
+		i = j + 1;
 	}
 	/// @todo Think about this
 	id.set("TA", '<' + tag + '>');
 }
 
+NmdcHub::Commands NmdcHub::getCommand(const char* aCmd, size_t aLen) {
+#define CMD(str, c) if(memcmp(aCmd, str, aLen) == 0) return c
+	// Switching on the length leaves only a handful of compares per command
+	switch(aLen) {
+	case 3:
+		CMD("$SR", CMD_SR);
+		break;
+	case 4:
+		CMD("$To:", CMD_TO);
+		CMD("$ZOn", CMD_ZON);
+		break;
+	case 5:
+		CMD("$Quit", CMD_QUIT);
+		CMD("$Lock", CMD_LOCK);
+		break;
+	case 6:
+		CMD("$Hello", CMD_HELLO);
+		break;
+	case 7:
+		CMD("$Search", CMD_SEARCH);
+		CMD("$MyINFO", CMD_MYINFO);
+		CMD("$UserIP", CMD_USERIP);
+		CMD("$OpList", CMD_OPLIST);
+		break;
+	case 8:
+		CMD("$HubName", CMD_HUBNAME);
+		CMD("$GetPass", CMD_GETPASS);
+		CMD("$BadPass", CMD_BADPASS);
+		break;
+	case 9:
+		CMD("$Supports", CMD_SUPPORTS);
+		CMD("$NickList", CMD_NICKLIST);
+		break;
+	case 10:
+		CMD("$ForceMove", CMD_FORCEMOVE);
+		CMD("$HubIsFull", CMD_HUBISFULL);
+		break;
+	case 12:
+		CMD("$ConnectToMe", CMD_CONNECTTOME);
+		CMD("$UserCommand", CMD_USERCOMMAND);
+		break;
+	case 15:
+		CMD("$RevConnectToMe", CMD_REVCONNECTTOME);
+		CMD("$ValidateDenide", CMD_VALIDATEDENIDE);		// Mind the spelling...
+		break;
+	}
+#undef CMD
+	return CMD_UNKNOWN;
+}
+
+void NmdcHub::onMyInfo(const string& aLine, string::size_type aStart) {
+	// $MyINFO $ALL <nick> <description><tag>$ $<connection><flag>$<email>$<sharesize>$
+	// The fields are located in the raw line; only the free text ones go through fromAcp
+	string::size_type i, j, x;
+	i = aStart + 5;
+	if(i >= aLine.length())
+		return;
+	j = aLine.find(' ', i);
+	if( (j == string::npos) || (j == i) )
+		return;
+	string nick = fromAcp(aLine.substr(i, j-i));
+
+	if(nick.empty())
+		return;
+
+	i = j + 1;
+
+	OnlineUser& u = getUser(nick);
+
+	// If he is already considered to be the hub (thus hidden), probably should appear in the UserList
+	if(u.getIdentity().isHidden()) {
+		u.getIdentity().setHidden(false);
+		u.getIdentity().setHub(false);
+	}
+
+	j = aLine.find('$', i);
+	if(j == string::npos)
+		return;
+
+	// Look for a tag...
+	string::size_type descEnd = j;
+	if(j > i && aLine[j-1] == '>') {
+		x = aLine.rfind('<', j-1);
+		if(x != string::npos && x >= i) {
+			// Hm, we have something...disassemble it...
+			updateFromTag(u.getIdentity(), fromAcp(aLine.substr(x + 1, j - x - 2)));
+			descEnd = x;
+		}
+	}
+	u.getIdentity().setDescription(unescape(fromAcp(aLine.substr(i, descEnd-i))));
+
+	i = j + 3;
+	if(i > aLine.length())
+		return;
+	j = aLine.find('$', i);
+	if(j == string::npos)
+		return;
+
+	string connection = (j > i) ? aLine.substr(i, j-i-1) : Util::emptyString;
+	if(connection.empty()) {
+		// No connection = bot...
+		u.getUser()->setFlag(User::BOT);
+		u.getIdentity().setHub(false);
+	} else {
+		u.getUser()->unsetFlag(User::BOT);
+		u.getIdentity().setBot(false);
+	}
+
+	u.getIdentity().setHub(false);
+
+	u.getIdentity().setConnection(connection);
+	i = j + 1;
+	j = aLine.find('$', i);
+
+	if(j == string::npos)
+		return;
+
+	u.getIdentity().setEmail(unescape(fromAcp(aLine.substr(i, j-i))));
+
+	i = j + 1;
+	j = aLine.find('$', i);
+	if(j == string::npos)
+		return;
+	u.getIdentity().setBytesShared(aLine.substr(i, j-i));
+
+	if(u.getUser() == getMyIdentity().getUser()) {
+		setMyIdentity(u.getIdentity());
+	}
+
+	updated(u);
+}
+
 void NmdcHub::onLine(const string& aLine) throw() {
 	updateActivity();
 
@@ -217,25 +359,25 @@ void NmdcHub::onLine(const string& aLine) throw() {
 			// Assume that messages from unknown users come from the hub
 			o.getIdentity().setHub(true);
 			o.getIdentity().setHidden(true);
-			fire(ClientListener::UserUpdated(), this, o);
+			updated(o);
+			flushUpdated();
 
 			fire(ClientListener::Message(), this, o, unescape(message));
 		}
 		return;
 	}
 
-	string cmd;
 	string param;
-	string::size_type x;
+	string::size_type x = aLine.find(' ');
+	Commands cmd = getCommand(aLine.data(), (x == string::npos) ? aLine.length() : x);
 
-	if( (x = aLine.find(' ')) == string::npos) {
-		cmd = aLine;
-	} else {
-		cmd = aLine.substr(0, x);
+	// $MyINFO converts its fields separately, $Lock and $SR want the raw line
+	if(x != string::npos && cmd != CMD_MYINFO && cmd != CMD_LOCK && cmd != CMD_SR) {
 		param = fromAcp(aLine.substr(x+1));
 	}
 
-	if(cmd == "$Search") {
+	switch(cmd) {
+	case CMD_SEARCH: {
 		if(state != STATE_CONNECTED) {
 			return;
 		}
@@ -325,92 +467,25 @@ void NmdcHub::onLine(const string& aLine) throw() {
 
 			fire(ClientListener::NmdcSearch(), this, seeker, a, Util::toInt64(size), type, terms);
 		}
-	} else if(cmd == "$MyINFO") {
-		string::size_type i, j;
-		i = 5;
-		j = param.find(' ', i);
-		if( (j == string::npos) || (j == i) )
-			return;
-		string nick = param.substr(i, j-i);
-
-		if(nick.empty())
-			return;
-
-		i = j + 1;
-
-		OnlineUser& u = getUser(nick);
-
-		// If he is already considered to be the hub (thus hidden), probably should appear in the UserList
-		if(u.getIdentity().isHidden()) {
-			u.getIdentity().setHidden(false);
-			u.getIdentity().setHub(false);
-		}
-
-		j = param.find('$', i);
-		if(j == string::npos)
-			return;
-
-		string tmpDesc = unescape(param.substr(i, j-i));
-		// Look for a tag...
-		if(tmpDesc.size() > 0 && tmpDesc[tmpDesc.size()-1] == '>') {
-			x = tmpDesc.rfind('<');
-			if(x != string::npos) {
-				// Hm, we have something...disassemble it...
-				updateFromTag(u.getIdentity(), tmpDesc.substr(x + 1, tmpDesc.length() - x - 2));
-				tmpDesc.erase(x);
-			}
-		}
-		u.getIdentity().setDescription(tmpDesc);
-
-		i = j + 3;
-		j = param.find('$', i);
-		if(j == string::npos)
-			return;
-
-		string connection = param.substr(i, j-i-1);
-		if(connection.empty()) {
-			// No connection = bot...
-			u.getUser()->setFlag(User::BOT);
-			u.getIdentity().setHub(false);
-		} else {
-			u.getUser()->unsetFlag(User::BOT);
-			u.getIdentity().setBot(false);
-		}
-
-		u.getIdentity().setHub(false);
-
-		u.getIdentity().setConnection(connection);
-		i = j + 1;
-		j = param.find('$', i);
-
-		if(j == string::npos)
-			return;
-
-		u.getIdentity().setEmail(unescape(param.substr(i, j-i)));
-
-		i = j + 1;
-		j = param.find('$', i);
-		if(j == string::npos)
-			return;
-		u.getIdentity().setBytesShared(param.substr(i, j-i));
-
-		if(u.getUser() == getMyIdentity().getUser()) {
-			setMyIdentity(u.getIdentity());
-		}
-
-		fire(ClientListener::UserUpdated(), this, u);
-	} else if(cmd == "$Quit") {
+	} break;
+	case CMD_MYINFO:
+		if(x != string::npos)
+			onMyInfo(aLine, x+1);
+		break;
+	case CMD_QUIT: {
 		if(!param.empty()) {
 			const string& nick = param;
 			OnlineUser* u = findUser(nick);
 			if(!u)
 				return;
 
+			flushUpdated();
 			fire(ClientListener::UserRemoved(), this, *u);
 
 			putUser(nick);
 		}
-	} else if(cmd == "$ConnectToMe") {
+	} break;
+	case CMD_CONNECTTOME: {
 		if(state != STATE_CONNECTED) {
 			return;
 		}
@@ -430,7 +505,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 		}
 		string port = param.substr(j+1);
 		ConnectionManager::getInstance()->nmdcConnect(server, (uint16_t)Util::toInt(port), getMyNick(), getHubUrl());
-	} else if(cmd == "$RevConnectToMe") {
+	} break;
+	case CMD_REVCONNECTTOME: {
 		if(state != STATE_CONNECTED) {
 			return;
 		}
@@ -456,9 +532,11 @@ void NmdcHub::onLine(const string& aLine) throw() {
 				return;
 			}
 		}
-	} else if(cmd == "$SR") {
+	} break;
+	case CMD_SR: {
 		SearchManager::getInstance()->onSearchResult(aLine);
-	} else if(cmd == "$HubName") {
+	} break;
+	case CMD_HUBNAME: {
 		// If " - " found, the first part goes to hub name, rest to description
 		// If no " - " found, first word goes to hub name, rest to description
 
@@ -477,7 +555,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 			getHubIdentity().setDescription(unescape(param.substr(i+3)));
 		}
 		fire(ClientListener::HubUpdated(), this);
-	} else if(cmd == "$Supports") {
+	} break;
+	case CMD_SUPPORTS: {
 		StringTokenizer<string> st(param, ' ');
 		StringList& sl = st.getTokens();
 		for(StringIter i = sl.begin(); i != sl.end(); ++i) {
@@ -489,7 +568,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 				supportFlags |= SUPPORTS_USERIP2;
 			}
 		}
-	} else if(cmd == "$UserCommand") {
+	} break;
+	case CMD_USERCOMMAND: {
 		string::size_type i = 0;
 		string::size_type j = param.find(' ');
 		if(j == string::npos)
@@ -514,7 +594,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 			string command = unescape(param.substr(i, param.length() - i));
 			fire(ClientListener::UserCommand(), this, type, ctx, name, command);
 		}
-	} else if(cmd == "$Lock") {
+	} break;
+	case CMD_LOCK: {
 		if(state != STATE_LOCK) {
 			return;
 		}
@@ -556,7 +637,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 			OnlineUser& ou = getUser(getCurrentNick());
 			validateNick(ou.getIdentity().getNick());
 		}
-	} else if(cmd == "$Hello") {
+	} break;
+	case CMD_HELLO: {
 		if(!param.empty()) {
 			OnlineUser& u = getUser(param);
 
@@ -577,17 +659,21 @@ void NmdcHub::onLine(const string& aLine) throw() {
 				myInfo(true);
 			}
 
-			fire(ClientListener::UserUpdated(), this, u);
+			updated(u);
 		}
-	} else if(cmd == "$ForceMove") {
+	} break;
+	case CMD_FORCEMOVE: {
 		socket->disconnect(false);
 		fire(ClientListener::Redirect(), this, param);
-	} else if(cmd == "$HubIsFull") {
+	} break;
+	case CMD_HUBISFULL: {
 		fire(ClientListener::HubFull(), this);
-	} else if(cmd == "$ValidateDenide") {		// Mind the spelling...
+	} break;
+	case CMD_VALIDATEDENIDE: {
 		socket->disconnect(false);
 		fire(ClientListener::NickTaken(), this);
-	} else if(cmd == "$UserIP") {
+	} break;
+	case CMD_USERIP: {
 		if(!param.empty()) {
 			OnlineUser::List v;
 			StringTokenizer<string> t(param, "$$");
@@ -613,7 +699,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 
 			fire(ClientListener::UsersUpdated(), this, v);
 		}
-	} else if(cmd == "$NickList") {
+	} break;
+	case CMD_NICKLIST: {
 		if(!param.empty()) {
 			OnlineUser::List v;
 			StringTokenizer<string> t(param, "$$");
@@ -643,7 +730,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 
 			fire(ClientListener::UsersUpdated(), this, v);
 		}
-	} else if(cmd == "$OpList") {
+	} break;
+	case CMD_OPLIST: {
 		if(!param.empty()) {
 			OnlineUser::List v;
 			StringTokenizer<string> t(param, "$$");
@@ -666,7 +754,8 @@ void NmdcHub::onLine(const string& aLine) throw() {
 			// updated when they log in (they'll be counted as registered first...)
 			myInfo(false);
 		}
-	} else if(cmd == "$To:") {
+	} break;
+	case CMD_TO: {
 		string::size_type i = param.find("From:");
 		if(i == string::npos)
 			return;
@@ -702,14 +791,14 @@ void NmdcHub::onLine(const string& aLine) throw() {
 				replyTo = &getUser(rtNick);
 				replyTo->getIdentity().setHub(true);
 				replyTo->getIdentity().setHidden(true);
-				fire(ClientListener::UserUpdated(), this, *replyTo);
+				updated(*replyTo);
 			}
 			if(from == 0) {
 				// Assume it's from the hub
 				from = &getUser(fromNick);
 				from->getIdentity().setHub(true);
 				from->getIdentity().setHidden(true);
-				fire(ClientListener::UserUpdated(), this, *from);
+				updated(*from);
 			}
 
 			// Update pointers just in case they've been invalidated
@@ -718,19 +807,25 @@ void NmdcHub::onLine(const string& aLine) throw() {
 		}
 
 		OnlineUser& to = getUser(getMyNick());
+		flushUpdated();
 		fire(ClientListener::PrivateMessage(), this, *from, to, *replyTo, unescape(msg));
-	} else if(cmd == "$GetPass") {
+	} break;
+	case CMD_GETPASS: {
 		OnlineUser& ou = getUser(getMyNick());
 		ou.getIdentity().set("RG", "1");
 		setMyIdentity(ou.getIdentity());
 		fire(ClientListener::GetPassword(), this);
-	} else if(cmd == "$BadPass") {
+	} break;
+	case CMD_BADPASS: {
 		setPassword(Util::emptyString);
-	} else if(cmd == "$ZOn") {
+	} break;
+	case CMD_ZON: {
 		socket->setMode(BufferedSocket::MODE_ZPIPE);
-	} else {
-		dcassert(cmd[0] == '$');
+	} break;
+	default:
+		dcassert(aLine[0] == '$');
 		dcdebug("NmdcHub::onLine Unknown command %s\n", aLine.c_str());
+		break;
 	}
 }
 
@@ -67,6 +67,31 @@ private:
 		SUPPORTS_USERIP2 = 0x04
 	};
 
+	enum Commands {
+		CMD_UNKNOWN,
+		CMD_SEARCH,
+		CMD_MYINFO,
+		CMD_QUIT,
+		CMD_CONNECTTOME,
+		CMD_REVCONNECTTOME,
+		CMD_SR,
+		CMD_HUBNAME,
+		CMD_SUPPORTS,
+		CMD_USERCOMMAND,
+		CMD_LOCK,
+		CMD_HELLO,
+		CMD_FORCEMOVE,
+		CMD_HUBISFULL,
+		CMD_VALIDATEDENIDE,
+		CMD_USERIP,
+		CMD_NICKLIST,
+		CMD_OPLIST,
+		CMD_TO,
+		CMD_GETPASS,
+		CMD_BADPASS,
+		CMD_ZON
+	};
+
 	enum States {
 		STATE_CONNECT,
 		STATE_LOCK,
@@ -98,6 +123,8 @@ private:
 
 	void clearUsers();
 	void onLine(const string& aLine) throw();
+	void onMyInfo(const string& aLine, string::size_type aStart);
+	static Commands getCommand(const char* aCmd, size_t aLen);
 
 	OnlineUser& getUser(const string& aNick);
 	OnlineUser* findUser(const string& aNick);
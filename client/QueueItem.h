@@ -117,14 +117,14 @@ public:
 	QueueItem(const string& aTarget, int64_t aSize,
 		Priority aPriority, int aFlag, int64_t aDownloadedBytes, uint32_t aAdded, const TTHValue& tth) :
 	Flags(aFlag), target(aTarget),
-		size(aSize), downloadedBytes(aDownloadedBytes), status(STATUS_WAITING),
+		size(aSize), downloadedBytes(aDownloadedBytes), verifiedBytes(0), status(STATUS_WAITING),
 		priority(aPriority), currentDownload(NULL), added(aAdded),
 		tthRoot(tth)
 	{ }
 
 	QueueItem(const QueueItem& rhs) :
 	Flags(rhs), target(rhs.target), tempTarget(rhs.tempTarget),
-		size(rhs.size), downloadedBytes(rhs.downloadedBytes), status(rhs.status), priority(rhs.priority),
+		size(rhs.size), downloadedBytes(rhs.downloadedBytes), verifiedBytes(rhs.verifiedBytes), status(rhs.status), priority(rhs.priority),
 		current(rhs.current), currentDownload(rhs.currentDownload), added(rhs.added), tthRoot(rhs.tthRoot),
 		sources(rhs.sources), badSources(rhs.badSources)
 	{
@@ -188,6 +188,8 @@ public:
 	string tempTarget;
 	GETSET(int64_t, size, Size);
 	GETSET(int64_t, downloadedBytes, DownloadedBytes);
+	/** Part of downloadedBytes already checked against the tree */
+	GETSET(int64_t, verifiedBytes, VerifiedBytes);
 	GETSET(Status, status, Status);
 	GETSET(Priority, priority, Priority);
 	GETSET(User::Ptr, current, Current);
@@ -311,7 +311,7 @@ QueueManager::QueueManager() : lastSave(0), queueFile(Util::getConfigPath() + "Q
 
 QueueManager::~QueueManager() throw() {
 	SearchManager::getInstance()->removeListener(this);
-	TimerManager::getInstance()->removeListener(this);
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	ClientManager::getInstance()->removeListener(this);
 
 	saveQueue();
@@ -811,6 +811,7 @@ void QueueManager::putDownload(Download* aDownload, bool finished) throw() {
 				} else {
 					if(!aDownload->isSet(Download::FLAG_TREE_DOWNLOAD)) {
 						q->setDownloadedBytes(aDownload->getPos());
+						q->setVerifiedBytes(min(aDownload->getVerifiedBytes(), q->getDownloadedBytes()));
 
 						if(q->getDownloadedBytes() > 0) {
 							q->setFlag(QueueItem::FLAG_EXISTS);
@@ -1084,6 +1085,10 @@ void QueueManager::saveQueue() throw() {
 					f.write(SimpleXML::escape(qi->getTempTarget(), tmp, true));
 					f.write(LIT("\" Downloaded=\""));
 					f.write(Util::toString(qi->getDownloadedBytes()));
+					if(qi->getVerifiedBytes() > 0) {
+						f.write(LIT("\" Verified=\""));
+						f.write(Util::toString(qi->getVerifiedBytes()));
+					}
 				}
 				f.write(LIT("\">\r\n"));
 
@@ -1153,6 +1158,7 @@ static const string sTempTarget = "TempTarget";
 static const string sTarget = "Target";
 static const string sSize = "Size";
 static const string sDownloaded = "Downloaded";
+static const string sVerified = "Verified";
 static const string sPriority = "Priority";
 static const string sSource = "Source";
 static const string sNick = "Nick";
@@ -1189,6 +1195,9 @@ void QueueLoader::startTag(const string& name, StringPairList& attribs, bool sim
 			int64_t downloaded = Util::toInt64(getAttrib(attribs, sDownloaded, 5));
 			if (downloaded > size || downloaded < 0)
 				downloaded = 0;
+			int64_t verified = Util::toInt64(getAttrib(attribs, sVerified, 6));
+			if(verified < 0)
+				verified = 0;
 
 			if(added == 0)
 				added = GET_TIME();
@@ -1197,6 +1206,7 @@ void QueueLoader::startTag(const string& name, StringPairList& attribs, bool sim
 
 			if(qi == NULL) {
 				qi = qm->fileQueue.add(target, size, flags, p, tempTarget, downloaded, added, TTHValue(tthRoot));
+				qi->setVerifiedBytes(min(verified, downloaded));
 				qm->fire(QueueManagerListener::Added(), qi);
 			}
 			if(!simple)
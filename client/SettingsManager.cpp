@@ -75,7 +75,8 @@ const string SettingsManager::settingTags[] =
 	"OpenWaitingUsers", "BoldWaitingUsers", "OpenSystemLog", "BoldSystemLog", "AutoRefreshTime",
 	"UseTLS", "AutoSearchLimit", "AltSortOrder", "AutoKickNoFavs", "PromptPassword", "SpyFrameIgnoreTthSearches",
 	"DontDlAlreadyQueued", "MaxCommandLength", "AllowUntrustedHubs", "AllowUntrustedClients",
-	"TLSPort", "FastHash",
+	"TLSPort", "FastHash", "ThrottleUpload", "ThrottleDownload", "ThrottleUploadConn", "ThrottleDownloadConn",
+	"ConnectAttempts",
 	"SENTRY",
 	// Int64
 	"TotalUpload", "TotalDownload",
@@ -191,6 +192,11 @@ SettingsManager::SettingsManager()
 	setDefault(LOG_SYSTEM, false);
 	setDefault(SEND_UNKNOWN_COMMANDS, true);
 	setDefault(MAX_HASH_SPEED, 0);
+	setDefault(THROTTLE_UPLOAD, 0);
+	setDefault(THROTTLE_DOWNLOAD, 0);
+	setDefault(THROTTLE_UPLOAD_CONN, 0);
+	setDefault(THROTTLE_DOWNLOAD_CONN, 0);
+	setDefault(CONNECT_ATTEMPTS, 5);
 	setDefault(OPEN_USER_CMD_HELP, true);
 	setDefault(GET_USER_COUNTRY, true);
 	setDefault(FAV_SHOW_JOINS, false);
@@ -91,7 +91,8 @@ public:
 		OPEN_WAITING_USERS, BOLD_WAITING_USERS, OPEN_SYSTEM_LOG, BOLD_SYSTEM_LOG, AUTO_REFRESH_TIME,
 		USE_TLS, AUTO_SEARCH_LIMIT, ALT_SORT_ORDER, AUTO_KICK_NO_FAVS, PROMPT_PASSWORD, SPY_FRAME_IGNORE_TTH_SEARCHES,
 		DONT_DL_ALREADY_QUEUED, MAX_COMMAND_LENGTH, ALLOW_UNTRUSTED_HUBS, ALLOW_UNTRUSTED_CLIENTS,
-		TLS_PORT, FAST_HASH,
+		TLS_PORT, FAST_HASH, THROTTLE_UPLOAD, THROTTLE_DOWNLOAD, THROTTLE_UPLOAD_CONN, THROTTLE_DOWNLOAD_CONN,
+		CONNECT_ATTEMPTS,
 		INT_LAST };
 
 	enum Int64Setting { INT64_FIRST = INT_LAST + 1,
@@ -55,7 +55,7 @@ ShareManager::ShareManager() : hits(0), xmlListLen(0), bzXmlListLen(0),
 
 ShareManager::~ShareManager() {
 	SettingsManager::getInstance()->removeListener(this);
-	TimerManager::getInstance()->removeListener(this);
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	DownloadManager::getInstance()->removeListener(this);
 	HashManager::getInstance()->removeListener(this);
 
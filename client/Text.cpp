@@ -266,6 +266,10 @@ string& Text::toLower(const string& str, string& tmp) throw() {
 */
 string Text::acpToUtf8(const string& str) throw()
 {
+	// 7-bit text is the same in every supported charset, skip the glib round trip
+	if(isAscii(str))
+		return str;
+
 	std::string utf8String;
 	gchar *utf8CString = g_filename_to_utf8(str.c_str(), -1, NULL, NULL, NULL);
 	if (utf8CString == NULL)
@@ -281,6 +285,9 @@ string Text::acpToUtf8(const string& str) throw()
 
 string Text::utf8ToAcp(const string& str) throw()
 {
+	if(isAscii(str))
+		return str;
+
 	std::string acpString;
 	gchar *acpCString;
 	if (g_getenv("G_FILENAME_ENCODING") != NULL)
@@ -297,7 +304,19 @@ string Text::utf8ToAcp(const string& str) throw()
 
 string Text::toLower(const string& str) throw()
 {
-	std::string lowerString = acpToUtf8(str);
+	// Plain table lookup until the first 8-bit character
+	string::size_type i = 0, n = str.size();
+	std::string lowerString(str);
+	for(; i < n; ++i) {
+		uint8_t c = (uint8_t)str[i];
+		if(c & 0x80)
+			break;
+		lowerString[i] = asciiLower[c];
+	}
+	if(i == n)
+		return lowerString;
+
+	lowerString = acpToUtf8(str);
 	gchar *lowerCString;
 	if (!lowerString.empty())
 	{
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2001-2006 Jacek Sieka, arnetheduck on gmail point com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#if !defined(THREADED_OUTPUT_STREAM_H)
+#define THREADED_OUTPUT_STREAM_H
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include "Streams.h"
+#include "Thread.h"
+#include "Semaphore.h"
+#include "CriticalSection.h"
+
+/**
+ * Hands written data to a worker thread that feeds the underlying stream, so that slow
+ * consumers (hashing, disk) don't hold up the writer. At most maxQueued bytes are kept
+ * in memory, after that write() blocks until the worker catches up.
+ * Errors from the worker are rethrown as FileException by the next write() or flush().
+ * Only one thread may write to / flush the stream.
+ */
+template<bool managed>
+class ThreadedOutputStream : public OutputStream, private Thread {
+public:
+	using OutputStream::write;
+
+	ThreadedOutputStream(OutputStream* aStream, size_t aMaxQueued) throw(ThreadException) :
+		s(aStream), maxQueued(aMaxQueued), queued(0), busy(false), stop(false)
+	{
+		start();
+	}
+
+	virtual ~ThreadedOutputStream() throw() {
+		// The worker writes out what's left before exiting, like BufferedOutputStream does
+		{
+			Lock l(cs);
+			stop = true;
+		}
+		work.signal();
+		join();
+		if(managed) delete s;
+	}
+
+	virtual size_t flush() throw(Exception) {
+		waitFor(0);
+		return s->flush();
+	}
+
+	virtual size_t write(const void* wbuf, size_t len) throw(Exception) {
+		if(len == 0)
+			return 0;
+
+		waitFor(maxQueued);
+
+		{
+			Lock l(cs);
+			if(spare.empty())
+				spare.push_back(ByteVector());
+			spare.front().assign((const uint8_t*)wbuf, (const uint8_t*)wbuf + len);
+			pending.splice(pending.end(), spare, spare.begin());
+			queued += len;
+		}
+		work.signal();
+		return len;
+	}
+
+private:
+	typedef vector<uint8_t> ByteVector;
+	typedef list<ByteVector> Chunks;
+
+	OutputStream* s;
+	size_t maxQueued;
+
+	CriticalSection cs;
+	/** Chunks waiting for the worker */
+	Chunks pending;
+	/** Buffers already handed back by the worker, reused to avoid allocations */
+	Chunks spare;
+	size_t queued;
+	bool busy;
+	bool stop;
+	string error;
+
+	/** Signalled when there's new data or the stream is being destroyed */
+	Semaphore work;
+	/** Signalled each time the worker finishes a chunk */
+	Semaphore done;
+
+	/**
+	 * Block until at most aBytes are queued. With 0 this waits for the worker to go idle,
+	 * even after an error, so the underlying streams may be inspected afterwards.
+	 */
+	void waitFor(size_t aBytes) throw(FileException) {
+		while(true) {
+			{
+				Lock l(cs);
+				bool idle = pending.empty() && !busy;
+				if(!error.empty() && (aBytes > 0 || idle))
+					throw FileException(error);
+				if(aBytes == 0 ? idle : (queued < aBytes))
+					return;
+			}
+			done.wait();
+		}
+	}
+
+	virtual int run() {
+		Chunks chunk;
+		while(true) {
+			work.wait();
+			while(true) {
+				{
+					Lock l(cs);
+					if(pending.empty()) {
+						if(stop)
+							return 0;
+						break;
+					}
+					chunk.splice(chunk.begin(), pending, pending.begin());
+					busy = true;
+				}
+
+				size_t n = chunk.front().size();
+				try {
+					// After a failure the data is useless, just drain the queue
+					bool ok;
+					{
+						Lock l(cs);
+						ok = error.empty();
+					}
+					if(ok)
+						s->write(&chunk.front()[0], n);
+				} catch(const Exception& e) {
+					Lock l(cs);
+					error = e.getError();
+				}
+
+				{
+					Lock l(cs);
+					queued -= n;
+					spare.splice(spare.end(), chunk, chunk.begin());
+					busy = false;
+				}
+				done.signal();
+			}
+		}
+	}
+};
+
+#endif // !defined(THREADED_OUTPUT_STREAM_H)
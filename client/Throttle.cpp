@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2001-2006 Jacek Sieka, arnetheduck on gmail point com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+#include "DCPlusPlus.h"
+
+#include "Throttle.h"
+
+#include "TimerManager.h"
+
+Throttle Throttle::up;
+Throttle Throttle::down;
+
+Throttle::Throttle() throw() : tokens(0), last(0) {
+}
+
+size_t Throttle::takeLimited(Throttle& aConn, int aConnRate, Throttle& aGlobal, int aGlobalRate, size_t aWanted) throw() {
+	size_t n = aConn.get(aConnRate, aWanted);
+	if(n == 0)
+		return 0;
+
+	size_t g = aGlobal.get(aGlobalRate, n);
+	if(g < n)
+		aConn.put(aConnRate, n - g);
+	return g;
+}
+
+void Throttle::refill(int64_t aRate) throw() {
+	uint32_t tick = GET_TICK();
+	// A full second refills any bucket, so there's no point in counting further
+	uint32_t elapsed = min(tick - last, (uint32_t)1000);
+	last = tick;
+
+	// Allow bursts of a fifth of a second so that writes stay reasonably large
+	int64_t cap = max(aRate / 5, (int64_t)MIN_CHUNK);
+	tokens = min(tokens + aRate * elapsed / 1000, cap);
+}
+
+size_t Throttle::get(int aRate, size_t aWanted) throw() {
+	if(aRate <= 0)
+		return aWanted;
+
+	FastLock l(cs);
+	refill((int64_t)aRate * 1024);
+	if(tokens < (int64_t)min(aWanted, (size_t)MIN_CHUNK))
+		return 0;
+
+	size_t n = (size_t)min((int64_t)aWanted, tokens);
+	tokens -= n;
+	return n;
+}
+
+void Throttle::put(int aRate, size_t aBytes) throw() {
+	if(aRate <= 0)
+		return;
+
+	FastLock l(cs);
+	tokens += aBytes;
+}
+
+uint32_t Throttle::wait(int aRate) throw() {
+	if(aRate <= 0)
+		return 0;
+
+	int64_t rate = (int64_t)aRate * 1024;
+	FastLock l(cs);
+	refill(rate);
+	if(tokens >= MIN_CHUNK)
+		return 0;
+	return (uint32_t)min((MIN_CHUNK - tokens) * 1000 / rate + 1, (int64_t)MAX_WAIT);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2001-2006 Jacek Sieka, arnetheduck on gmail point com
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#if !defined(THROTTLE_H)
+#define THROTTLE_H
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include "CriticalSection.h"
+
+/**
+ * Token bucket used to shape bulk transfers. Rates are passed in on each call (in KiB/s,
+ * 0 meaning unlimited) so that settings changes take effect immediately; an unlimited
+ * bucket is never locked.
+ * Buckets are chained: a connection takes from its own bucket first and then from the
+ * global one for its direction.
+ */
+class Throttle {
+public:
+	Throttle() throw();
+
+	/**
+	 * Take tokens for up to aWanted bytes from both aConn and aGlobal.
+	 * @return The number of bytes that may be transferred now, 0 if either bucket is dry
+	 */
+	static size_t take(Throttle& aConn, int aConnRate, Throttle& aGlobal, int aGlobalRate, size_t aWanted) throw() {
+		if(aConnRate <= 0 && aGlobalRate <= 0)
+			return aWanted;
+		return takeLimited(aConn, aConnRate, aGlobal, aGlobalRate, aWanted);
+	}
+	/** Return tokens that take() handed out but weren't used */
+	static void giveBack(Throttle& aConn, int aConnRate, Throttle& aGlobal, int aGlobalRate, size_t aBytes) throw() {
+		if(aBytes == 0 || (aConnRate <= 0 && aGlobalRate <= 0))
+			return;
+		aConn.put(aConnRate, aBytes);
+		aGlobal.put(aGlobalRate, aBytes);
+	}
+	/** Milliseconds until take() can be expected to succeed again */
+	static uint32_t getWait(Throttle& aConn, int aConnRate, Throttle& aGlobal, int aGlobalRate) throw() {
+		return max(aConn.wait(aConnRate), aGlobal.wait(aGlobalRate));
+	}
+
+	/** Buckets shared by all connections */
+	static Throttle up;
+	static Throttle down;
+
+private:
+	enum {
+		/** Smallest amount worth a syscall, except for the tail of a transfer */
+		MIN_CHUNK = 1024,
+		/** Longest wait reported, so that sockets still check their tasks */
+		MAX_WAIT = 250
+	};
+
+	FastCriticalSection cs;
+	int64_t tokens;
+	uint32_t last;
+
+	static size_t takeLimited(Throttle& aConn, int aConnRate, Throttle& aGlobal, int aGlobalRate, size_t aWanted) throw();
+
+	void refill(int64_t aRate) throw();
+	size_t get(int aRate, size_t aWanted) throw();
+	void put(int aRate, size_t aBytes) throw();
+	uint32_t wait(int aRate) throw();
+
+	Throttle(const Throttle&);
+	Throttle& operator=(const Throttle&);
+};
+
+#endif // !defined(THROTTLE_H)
@@ -20,27 +20,347 @@
 #include "DCPlusPlus.h"
 
 #include "TimerManager.h"
+#include "Pointer.h"
 
 #ifndef _WIN32
-timeval TimerManager::tv;
+uint64_t TimerManager::startTick = TimerManager::getMonotonic();
 #endif
 
+TimerManager::TimerManager() : stop(false), current(0), base(getTick()), lastId(0) {
+	for(int i = 0; i < WORKERS; ++i)
+		workers[i].tm = this;
+
+	schedule(new Timer(TimerManagerListener::Second::TYPE, 0, NULL, toTicks(1000), toTicks(1000)));
+	schedule(new Timer(TimerManagerListener::Minute::TYPE, 0, NULL, toTicks(60*1000), toTicks(60*1000)));
+}
+
+TimerManager::~TimerManager() throw() {
+	dcassert(entries.empty());
+	shutdown();
+
+	for(int i = 0; i < SLOTS; ++i)
+		for_each(slots[i].begin(), slots[i].end(), DeleteFunction());
+	for_each(entries.begin(), entries.end(), DeleteFunction());
+}
+
+void TimerManager::addListener(TimerManagerListener* aListener) throw() {
+	Lock l(cs);
+	if(!findEntry(aListener))
+		entries.push_back(new Entry(aListener));
+}
+
+void TimerManager::removeListener(TimerManagerListener* aListener) throw() {
+	Lock l(cs);
+	detach(aListener);
+}
+
+void TimerManager::removeListenerAndWait(TimerManagerListener* aListener) throw() {
+	Semaphore done;
+	{
+		Lock l(cs);
+		Entry* e = detach(aListener);
+		if(!e || isCurrentThread(e->runner))
+			return;
+		e->done = &done;
+	}
+	done.wait();
+}
+
+/** Forget aListener and its timers. @return The entry if a worker is still calling it; the worker deletes it */
+TimerManager::Entry* TimerManager::detach(TimerManagerListener* aListener) {
+	EntryIter i;
+	for(i = entries.begin(); i != entries.end() && (*i)->listener != aListener; ++i)
+		;
+	if(i == entries.end())
+		return NULL;
+
+	Entry* e = *i;
+	entries.erase(i);
+
+	for(HASH_MAP<uint32_t, Timer*>::iterator j = timers.begin(); j != timers.end(); ) {
+		if(j->second->listener == aListener) {
+			unlink(j->second);
+			delete j->second;
+			timers.erase(j++);
+		} else {
+			++j;
+		}
+	}
+
+	if(e->queued)
+		queue.erase(find(queue.begin(), queue.end(), e));
+
+	if(!e->running) {
+		delete e;
+		return NULL;
+	}
+
+	e->removed = true;
+	return e;
+}
+
+uint32_t TimerManager::addTimer(TimerManagerListener* aListener, uint32_t aDelay, uint32_t aInterval /* = 0 */) throw() {
+	uint32_t id;
+	{
+		Lock l(cs);
+		do {
+			id = ++lastId;
+		} while(id == 0 || timers.find(id) != timers.end());
+
+		// The current tick may already be partly gone, so round the delay up
+		uint32_t now = getTick();
+		uint32_t due = current;
+		if((int32_t)(now - tickTime(current)) > 0)
+			due = (now - base) / RESOLUTION + 1;
+
+		Timer* t = new Timer(TimerManagerListener::Timer::TYPE, id, aListener, due + toTicks(aDelay), toTicks(aInterval));
+		timers[id] = t;
+		schedule(t);
+	}
+	// Wake up the timer thread in case this is due before whatever it's waiting for
+	s.signal();
+	return id;
+}
+
+void TimerManager::removeTimer(uint32_t aId) throw() {
+	Lock l(cs);
+	HASH_MAP<uint32_t, Timer*>::iterator i = timers.find(aId);
+	if(i == timers.end())
+		return;
+
+	Timer* t = i->second;
+	Entry* e = findEntry(t->listener);
+	if(e) {
+		for(deque<Task>::iterator j = e->tasks.begin(); j != e->tasks.end(); ) {
+			if(j->type == TimerManagerListener::Timer::TYPE && j->id == aId)
+				j = e->tasks.erase(j);
+			else
+				++j;
+		}
+	}
+
+	unlink(t);
+	delete t;
+	timers.erase(i);
+}
+
+TimerManager::Stats TimerManager::getStats(TimerManagerListener* aListener) throw() {
+	Lock l(cs);
+	Entry* e = findEntry(aListener);
+	return e ? e->stats : Stats();
+}
+
 int TimerManager::run() {
-	int nextMin = 0;
+	for(int i = 0; i < WORKERS; ++i)
+		workers[i].start();
 
-	uint32_t x = getTick();
-	uint32_t nextTick = x + 1000;
+	while(!stop) {
+		uint32_t now = getTick();
+		uint32_t wait;
+		{
+			Lock l(cs);
+			uint32_t nowTick = (now - base) / RESOLUTION;
+			while((int32_t)(nowTick - current) >= 0)
+				advance(nowTick);
 
-	while(!s.wait(nextTick > x ? nextTick - x : 0)) {
-		uint32_t z = getTick();
-		nextTick = z + 1000;
-		fire(TimerManagerListener::Second(), z);
-		if(nextMin++ >= 60) {
-			fire(TimerManagerListener::Minute(), z);
-			nextMin = 0;
+			int32_t left = (int32_t)(tickTime(nextDue()) - now);
+			wait = left > 0 ? (uint32_t)left : 0;
 		}
-		x = getTick();
+		s.wait(wait);
 	}
 
+	for(int i = 0; i < WORKERS; ++i)
+		ready.signal();
+	for(int i = 0; i < WORKERS; ++i)
+		workers[i].join();
+
 	return 0;
 }
+
+int TimerManager::work() {
+	for(;;) {
+		ready.wait();
+
+		Lock l(cs);
+		if(queue.empty()) {
+			if(stop)
+				break;
+			continue;
+		}
+
+		Entry* e = queue.front();
+		queue.pop_front();
+		e->queued = false;
+		e->running = true;
+		e->runner = currentThread();
+
+		while(!e->removed && !e->tasks.empty()) {
+			Task t = e->tasks.front();
+			e->tasks.pop_front();
+
+			uint32_t tick = getTick();
+			uint32_t late = (int32_t)(tick - t.due) > 0 ? tick - t.due : 0;
+			e->stats.calls++;
+			e->stats.lateTotal += late;
+			if(late > e->stats.lateMax)
+				e->stats.lateMax = late;
+
+			cs.leave();
+			call(e->listener, t, tick);
+			cs.enter();
+		}
+
+		e->running = false;
+		if(e->removed) {
+			if(e->done)
+				e->done->signal();
+			delete e;
+		}
+	}
+	return 0;
+}
+
+void TimerManager::call(TimerManagerListener* aListener, const Task& aTask, uint32_t aTick) {
+	switch(aTask.type) {
+		case TimerManagerListener::Second::TYPE:
+			aListener->on(TimerManagerListener::Second(), aTick); break;
+		case TimerManagerListener::Minute::TYPE:
+			aListener->on(TimerManagerListener::Minute(), aTick); break;
+		case TimerManagerListener::Timer::TYPE:
+			aListener->on(TimerManagerListener::Timer(), aTask.id, aTick); break;
+	}
+}
+
+void TimerManager::schedule(Timer* aTimer) {
+	if((int32_t)(aTimer->due - current) < 0)
+		aTimer->due = current;
+
+	uint32_t delta = aTimer->due - current;
+	if(delta < LEVEL0_SIZE) {
+		aTimer->slot = aTimer->due & (LEVEL0_SIZE - 1);
+	} else {
+		int level = 1;
+		int shift = LEVEL0_BITS;
+		while(level < LEVELS - 1 && delta >= (1u << (shift + LEVEL_BITS))) {
+			level++;
+			shift += LEVEL_BITS;
+		}
+
+		// Too far for the wheel; park it in the last slot, the cascade puts it back
+		uint32_t due = aTimer->due;
+		if(delta >= (1u << (shift + LEVEL_BITS)))
+			due = current + (1u << (shift + LEVEL_BITS)) - 1;
+
+		aTimer->slot = LEVEL0_SIZE + (level - 1) * LEVEL_SIZE + ((due >> shift) & (LEVEL_SIZE - 1));
+	}
+	slots[aTimer->slot].push_back(aTimer);
+}
+
+void TimerManager::unlink(Timer* aTimer) {
+	TimerList& l = slots[aTimer->slot];
+	TimerIter i = find(l.begin(), l.end(), aTimer);
+	if(i != l.end())
+		l.erase(i);
+}
+
+uint32_t TimerManager::cascade(int aLevel) {
+	int shift = LEVEL0_BITS + (aLevel - 1) * LEVEL_BITS;
+	uint32_t index = (current >> shift) & (LEVEL_SIZE - 1);
+
+	TimerList l;
+	l.swap(slots[LEVEL0_SIZE + (aLevel - 1) * LEVEL_SIZE + index]);
+	for(TimerIter i = l.begin(); i != l.end(); ++i)
+		schedule(*i);
+	return index;
+}
+
+void TimerManager::advance(uint32_t aNowTick) {
+	uint32_t index = current & (LEVEL0_SIZE - 1);
+	if(index == 0) {
+		for(int level = 1; level < LEVELS && cascade(level) == 0; ++level)
+			;
+	}
+
+	TimerList l;
+	l.swap(slots[index]);
+	for(TimerIter i = l.begin(); i != l.end(); ++i)
+		expire(*i, aNowTick);
+	current++;
+}
+
+void TimerManager::expire(Timer* aTimer, uint32_t aNowTick) {
+	Task task(aTimer->type, aTimer->id, tickTime(aTimer->due));
+	if(aTimer->listener) {
+		Entry* e = findEntry(aTimer->listener);
+		if(e)
+			post(e, task);
+	} else {
+		for(EntryIter i = entries.begin(); i != entries.end(); ++i)
+			post(*i, task);
+	}
+
+	if(aTimer->interval == 0) {
+		timers.erase(aTimer->id);
+		delete aTimer;
+		return;
+	}
+
+	// After a stall, skip the missed periods instead of firing them all at once
+	aTimer->due += aTimer->interval;
+	if((int32_t)(aTimer->due - aNowTick) <= 0)
+		aTimer->due = aNowTick + 1;
+	schedule(aTimer);
+}
+
+void TimerManager::post(Entry* aEntry, const Task& aTask) {
+	// A listener that hasn't handled the previous Second or Minute yet doesn't need another one
+	if(aTask.type != TimerManagerListener::Timer::TYPE) {
+		for(deque<Task>::iterator i = aEntry->tasks.begin(); i != aEntry->tasks.end(); ++i) {
+			if(i->type == aTask.type) {
+				aEntry->stats.skipped++;
+				return;
+			}
+		}
+	}
+
+	aEntry->tasks.push_back(aTask);
+	if(!aEntry->queued && !aEntry->running) {
+		aEntry->queued = true;
+		queue.push_back(aEntry);
+		ready.signal();
+	}
+}
+
+uint32_t TimerManager::nextDue() const {
+	// Only the first level needs looking at, the rest are cascaded down at its end
+	uint32_t end = (current | (LEVEL0_SIZE - 1)) + 1;
+	for(uint32_t t = current; t != end; ++t) {
+		if(!slots[t & (LEVEL0_SIZE - 1)].empty())
+			return t;
+	}
+	return end;
+}
+
+TimerManager::Entry* TimerManager::findEntry(TimerManagerListener* aListener) {
+	for(EntryIter i = entries.begin(); i != entries.end(); ++i) {
+		if((*i)->listener == aListener)
+			return *i;
+	}
+	return NULL;
+}
+
+TimerManager::ThreadId TimerManager::currentThread() {
+#ifdef _WIN32
+	return GetCurrentThreadId();
+#else
+	return pthread_self();
+#endif
+}
+
+bool TimerManager::isCurrentThread(ThreadId aId) {
+#ifdef _WIN32
+	return aId == GetCurrentThreadId();
+#else
+	return pthread_equal(aId, pthread_self()) != 0;
+#endif
+}
@@ -25,11 +25,11 @@
 
 #include "Thread.h"
 #include "Semaphore.h"
-#include "Speaker.h"
+#include "CriticalSection.h"
 #include "Singleton.h"
 
 #ifndef _WIN32
-#include <sys/time.h>
+#include <time.h>
 #endif
 
 class TimerManagerListener {
@@ -39,16 +39,56 @@ public:
 
 	typedef X<0> Second;
 	typedef X<1> Minute;
+	typedef X<2> Timer;
 
 	// We expect everyone to implement this...
 	virtual void on(Second, uint32_t) throw() { }
 	virtual void on(Minute, uint32_t) throw() { }
+	/** A timer added with TimerManager::addTimer expired; the id is the one addTimer returned */
+	virtual void on(Timer, uint32_t /*aId*/, uint32_t) throw() { }
 };
 
-class TimerManager : public Speaker<TimerManagerListener>, public Singleton<TimerManager>, public Thread
+/**
+ * Keeps the timers on a hierarchical timing wheel and hands expired ones to a small
+ * pool of worker threads, so a slow handler only delays its own listener. Calls to
+ * the same listener are never run concurrently and are delivered in order.
+ */
+class TimerManager : public Singleton<TimerManager>, public Thread
 {
 public:
+	/** How late the calls to one listener were delivered, in milliseconds */
+	struct Stats {
+		Stats() : calls(0), skipped(0), lateMax(0), lateTotal(0) { }
+		uint32_t calls;
+		/** Second and Minute ticks dropped because the previous one was still pending */
+		uint32_t skipped;
+		uint32_t lateMax;
+		uint64_t lateTotal;
+	};
+
+	void addListener(TimerManagerListener* aListener) throw();
+	/** No new calls are made to aListener, though one may still be running */
+	void removeListener(TimerManagerListener* aListener) throw();
+	/**
+	 * Like removeListener, but also waits for a running call to return, unless it's
+	 * called from that call. Use it before the listener is destroyed, and never while
+	 * holding a lock the listener's handlers take.
+	 */
+	void removeListenerAndWait(TimerManagerListener* aListener) throw();
+
+	/**
+	 * Call aListener with on(Timer) after aDelay milliseconds, and then every
+	 * aInterval milliseconds if it's not 0. The listener must be added with
+	 * addListener, its timers are removed with it.
+	 * @return Id for removeTimer, never 0
+	 */
+	uint32_t addTimer(TimerManagerListener* aListener, uint32_t aDelay, uint32_t aInterval = 0) throw();
+	void removeTimer(uint32_t aId) throw();
+
+	Stats getStats(TimerManagerListener* aListener) throw();
+
 	void shutdown() {
+		stop = true;
 		s.signal();
 		join();
 	}
@@ -60,31 +100,118 @@ public:
 #ifdef _WIN32
 		return GetTickCount();
 #else
-		timeval tv2;
-		gettimeofday(&tv2, NULL);
-		return (uint32_t)((tv2.tv_sec - tv.tv_sec) * 1000 ) + ( (tv2.tv_usec - tv.tv_usec) / 1000);
+		return (uint32_t)(getMonotonic() - startTick);
 #endif
 	}
 private:
+	enum {
+		RESOLUTION = 100,		// milliseconds per wheel tick
+		LEVEL0_BITS = 8,
+		LEVEL_BITS = 6,
+		LEVELS = 3,
+		LEVEL0_SIZE = 1 << LEVEL0_BITS,
+		LEVEL_SIZE = 1 << LEVEL_BITS,
+		SLOTS = LEVEL0_SIZE + (LEVELS - 1) * LEVEL_SIZE,
+		WORKERS = 2
+	};
+
+	struct Timer {
+		Timer(int aType, uint32_t aId, TimerManagerListener* aListener, uint32_t aDue, uint32_t aInterval) :
+			type(aType), id(aId), listener(aListener), due(aDue), interval(aInterval), slot(0) { }
+		int type;						// TimerManagerListener::X<>::TYPE
+		uint32_t id;
+		TimerManagerListener* listener;	// NULL for Second and Minute, which go to everyone
+		uint32_t due;					// in wheel ticks, like interval
+		uint32_t interval;
+		int slot;
+	};
+	typedef vector<Timer*> TimerList;
+	typedef TimerList::iterator TimerIter;
+
+	struct Task {
+		Task(int aType, uint32_t aId, uint32_t aDue) : type(aType), id(aId), due(aDue) { }
+		int type;
+		uint32_t id;
+		uint32_t due;					// getTick() when it should have run
+	};
 
-	Semaphore s;
+#ifdef _WIN32
+	typedef DWORD ThreadId;
+#else
+	typedef pthread_t ThreadId;
+#endif
+
+	/** Pending calls to one listener; it's either idle, waiting in ready or run by a worker */
+	struct Entry {
+		Entry(TimerManagerListener* aListener) : listener(aListener), queued(false), running(false), removed(false), done(NULL) { }
+		TimerManagerListener* listener;
+		deque<Task> tasks;
+		bool queued;
+		bool running;
+		bool removed;
+		Semaphore* done;				// signaled when a removed entry's call returns
+		ThreadId runner;
+		Stats stats;
+	};
+	typedef vector<Entry*> EntryList;
+	typedef EntryList::iterator EntryIter;
+
+	class Worker : public Thread {
+	public:
+		Worker() : tm(NULL) { }
+		TimerManager* tm;
+	private:
+		virtual int run() { return tm->work(); }
+	};
 
 	friend class Singleton<TimerManager>;
-	TimerManager() {
-#ifndef _WIN32
-		gettimeofday(&tv, NULL);
-#endif
-	}
+	friend class Worker;
 
-	virtual ~TimerManager() throw() {
-		dcassert(listeners.empty());
-		shutdown();
-	}
+	TimerManager();
+	virtual ~TimerManager() throw();
 
 	virtual int run();
+	int work();
+
+	uint32_t toTicks(uint32_t aMillis) const { return aMillis / RESOLUTION + ((aMillis % RESOLUTION) ? 1 : 0); }
+	uint32_t tickTime(uint32_t aTick) const { return base + aTick * RESOLUTION; }
+
+	void schedule(Timer* aTimer);
+	void unlink(Timer* aTimer);
+	uint32_t cascade(int aLevel);
+	void advance(uint32_t aNowTick);
+	void expire(Timer* aTimer, uint32_t aNowTick);
+	void post(Entry* aEntry, const Task& aTask);
+	uint32_t nextDue() const;
+	Entry* findEntry(TimerManagerListener* aListener);
+	Entry* detach(TimerManagerListener* aListener);
+
+	static void call(TimerManagerListener* aListener, const Task& aTask, uint32_t aTick);
+	static ThreadId currentThread();
+	static bool isCurrentThread(ThreadId aId);
+
+	CriticalSection cs;
+	Semaphore s;
+	Semaphore ready;
+	volatile bool stop;
+
+	TimerList slots[SLOTS];
+	HASH_MAP<uint32_t, Timer*> timers;
+	uint32_t current;				// next wheel tick to process
+	uint32_t base;					// getTick() at wheel tick 0
+	uint32_t lastId;
+
+	EntryList entries;
+	deque<Entry*> queue;			// listeners with tasks, waiting for a worker
+	Worker workers[WORKERS];
 
 #ifndef _WIN32
-	static timeval tv;
+	static uint64_t getMonotonic() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	}
+	static uint64_t startTick;
 #endif
 };
 
@@ -58,7 +58,7 @@ UploadManager::UploadManager() throw() : running(0), extra(0), lastGrant(0) {
 }
 
 UploadManager::~UploadManager() throw() {
-	TimerManager::getInstance()->removeListener(this);
+	TimerManager::getInstance()->removeListenerAndWait(this);
 	ClientManager::getInstance()->removeListener(this);
 	while(true) {
 		{
@@ -317,8 +317,11 @@ void UploadManager::on(AdcCommand::GET, UserConnection* aSource, const AdcComman
 			.addParam(Util::toString(u->getPos()))
 			.addParam(Util::toString(u->getSize() - u->getPos()));
 
-		if(c.hasFlag("ZL", 4)) {
-			u->setStream(new FilteredInputStream<ZFilter, true>(u->getStream()));
+		if(c.hasFlag("ZL", 4) && isCompressible(*u, fname)) {
+			if(u->getSize() - u->getPos() > FAST_COMPRESSION_SIZE)
+				u->setStream(new FilteredInputStream<FastZFilter, true>(u->getStream()));
+			else
+				u->setStream(new FilteredInputStream<ZFilter, true>(u->getStream()));
 			u->setFlag(Upload::FLAG_ZUPLOAD);
 			cmd.addParam("ZL1");
 		}
@@ -332,6 +335,23 @@ void UploadManager::on(AdcCommand::GET, UserConnection* aSource, const AdcComman
 	}
 }
 
+bool UploadManager::isCompressible(const Upload& aUpload, const string& aFile) {
+	if(aFile == Transfer::USER_LIST_NAME_BZ)
+		return false;
+	if(aUpload.isSet(Upload::FLAG_TTH_LEAVES) || aUpload.isSet(Upload::FLAG_PARTIAL_LIST) || aUpload.isSet(Upload::FLAG_USER_LIST))
+		return true;
+
+	switch(ShareManager::getInstance()->getType(aUpload.getSourceFile())) {
+		case SearchManager::TYPE_AUDIO:
+		case SearchManager::TYPE_COMPRESSED:
+		case SearchManager::TYPE_PICTURE:
+		case SearchManager::TYPE_VIDEO:
+			return false;
+		default:
+			return true;
+	}
+}
+
 void UploadManager::on(UserConnectionListener::BytesSent, UserConnection* aSource, size_t aBytes, size_t aActual) throw() {
 	dcassert(aSource->getState() == UserConnection::STATE_RUNNING);
 	Upload* u = aSource->getUpload();
@@ -134,6 +134,11 @@ private:
 	FilesMap waitingFiles;		//set of files which this user has asked for
 	void addFailedUpload(const UserConnection& source, string filename);
 
+	/** Transfers larger than this are compressed at the fastest zlib level */
+	static const int64_t FAST_COMPRESSION_SIZE = 16*1024*1024;
+	/** @return False for files that are already compressed, ZL1 would only waste cpu on them */
+	static bool isCompressible(const Upload& aUpload, const string& aFile);
+
 	friend class Singleton<UploadManager>;
 	UploadManager() throw();
 	virtual ~UploadManager() throw();
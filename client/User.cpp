@@ -28,18 +28,91 @@ OnlineUser::OnlineUser(const User::Ptr& ptr, Client& client_, uint32_t sid_) : i
 
 }
 
+Identity::Identity(const Identity& rhs) : Flags(rhs), user(rhs.user), sid(rhs.sid)
+{
+	FastLock l(rhs.cs);
+	info = rhs.info;
+	nick = rhs.nick;
+	ip = rhs.ip;
+	infoFlags = rhs.infoFlags;
+	bytesShared = rhs.bytesShared;
+	slots = rhs.slots;
+	udpPort = rhs.udpPort;
+	away = rhs.away;
+}
+
+Identity& Identity::operator=(const Identity& rhs) {
+	if(this != &rhs) {
+		Identity tmp(rhs);
+		swap(tmp);
+	}
+	return *this;
+}
+
+void Identity::swap(Identity& rhs) {
+	FastLock l(cs);
+	*static_cast<Flags*>(this) = rhs;
+	user = rhs.user;
+	sid = rhs.sid;
+	info.swap(rhs.info);
+	nick.swap(rhs.nick);
+	ip.swap(rhs.ip);
+	infoFlags = rhs.infoFlags;
+	bytesShared = rhs.bytesShared;
+	slots = rhs.slots;
+	udpPort = rhs.udpPort;
+	away = rhs.away;
+}
+
+Identity::Fields Identity::getField(const char* name) {
+	switch(name[0]) {
+		case 'N': if(name[1] == 'I') return FIELD_NI; break;
+		case 'I': if(name[1] == '4') return FIELD_I4; break;
+		case 'U': if(name[1] == '4') return FIELD_U4; break;
+		case 'S': if(name[1] == 'S') return FIELD_SS; if(name[1] == 'L') return FIELD_SL; break;
+		case 'A': if(name[1] == 'W') return FIELD_AW; break;
+		case 'O': if(name[1] == 'P') return FIELD_OP; break;
+		case 'B': if(name[1] == 'O') return FIELD_BO; break;
+		case 'H': if(name[1] == 'U') return FIELD_HU; if(name[1] == 'I') return FIELD_HI; break;
+		case 'R': if(name[1] == 'G') return FIELD_RG; break;
+	}
+	return FIELD_OTHER;
+}
+
+int Identity::flagOf(Fields f) {
+	switch(f) {
+		case FIELD_OP: return INFO_OP;
+		case FIELD_BO: return INFO_BOT;
+		case FIELD_HU: return INFO_HUB;
+		case FIELD_HI: return INFO_HIDDEN;
+		case FIELD_RG: return INFO_REGISTERED;
+		default: return 0;
+	}
+}
+
 void Identity::getParams(StringMap& sm, const string& prefix, bool compatibility) const {
 	{
-		Lock l(cs);
+		FastLock l(cs);
 		for(InfMap::const_iterator i = info.begin(); i != info.end(); ++i) {
 			sm[prefix + string((char*)(&i->first), 2)] = i->second;
 		}
+		if(!nick.empty())
+			sm[prefix + "NI"] = nick;
+		if(!ip.empty())
+			sm[prefix + "I4"] = ip;
 	}
+	static const char* numbered[] = { "U4", "SS", "SL", "AW", "OP", "BO", "HU", "HI", "RG" };
+	for(size_t i = 0; i < sizeof(numbered) / sizeof(numbered[0]); ++i) {
+		string v = get(numbered[i]);
+		if(!v.empty())
+			sm[prefix + numbered[i]] = v;
+	}
+
 	if(user) {
 		sm[prefix + "SID"] = getSIDString();
 		sm[prefix + "CID"] = user->getCID().toBase32();
 		sm[prefix + "TAG"] = getTag();
-		sm[prefix + "SSshort"] = Util::formatBytes(get("SS"));
+		sm[prefix + "SSshort"] = Util::formatBytes(getBytesShared());
 
 		if(compatibility) {
 			if(prefix == "my") {
@@ -48,12 +121,12 @@ void Identity::getParams(StringMap& sm, const string& prefix, bool compatibility
 			} else {
 				sm["nick"] = getNick();
 				sm["cid"] = user->getCID().toBase32();
-				sm["ip"] = get("I4");
+				sm["ip"] = getIp();
 				sm["tag"] = getTag();
 				sm["description"] = get("DE");
 				sm["email"] = get("EM");
 				sm["share"] = get("SS");
-				sm["shareshort"] = Util::formatBytes(get("SS"));
+				sm["shareshort"] = Util::formatBytes(getBytesShared());
 			}
 		}
 	}
@@ -62,23 +135,66 @@ void Identity::getParams(StringMap& sm, const string& prefix, bool compatibility
 string Identity::getTag() const {
 	if(!get("TA").empty())
 		return get("TA");
-	if(get("VE").empty() || get("HN").empty() || get("HR").empty() ||get("HO").empty() || get("SL").empty())
+	if(get("VE").empty() || get("HN").empty() || get("HR").empty() ||get("HO").empty() || !hasInfo(INFO_SLOTS))
 		return Util::emptyString;
 	return "<" + get("VE") + ",M:" + string(isTcpActive() ? "A" : "P") + ",H:" + get("HN") + "/" +
-		get("HR") + "/" + get("HO") + ",S:" + get("SL") + ">";
+		get("HR") + "/" + get("HO") + ",S:" + Util::toString(getSlots()) + ">";
 }
+
 string Identity::get(const char* name) const {
-	Lock l(cs);
+	Fields f = getField(name);
+	FastLock l(cs);
+	switch(f) {
+		case FIELD_NI: return nick;
+		case FIELD_I4: return ip;
+		case FIELD_U4: return udpPort ? Util::toString(udpPort) : Util::emptyString;
+		case FIELD_SS: return (infoFlags & INFO_SHARE) ? Util::toString(bytesShared) : Util::emptyString;
+		case FIELD_SL: return (infoFlags & INFO_SLOTS) ? Util::toString(slots) : Util::emptyString;
+		case FIELD_AW: return away ? Util::toString((int)away) : Util::emptyString;
+		case FIELD_OTHER: break;
+		default: return (infoFlags & flagOf(f)) ? "1" : Util::emptyString;
+	}
+
 	InfMap::const_iterator i = info.find(*(short*)name);
 	return i == info.end() ? Util::emptyString : i->second;
 }
 
 void Identity::set(const char* name, const string& val) {
-	Lock l(cs);
-	if(val.empty())
-		info.erase(*(short*)name);
-	else
-		info[*(short*)name] = val;
+	Fields f = getField(name);
+	FastLock l(cs);
+	switch(f) {
+		case FIELD_NI:
+			nick = val;
+			break;
+		case FIELD_I4:
+			ip = val;
+			infoFlags = val.empty() ? (infoFlags & ~INFO_IP) : (infoFlags | INFO_IP);
+			break;
+		case FIELD_U4:
+			udpPort = static_cast<uint16_t>(Util::toInt(val));
+			break;
+		case FIELD_SS:
+			bytesShared = Util::toInt64(val);
+			infoFlags = val.empty() ? (infoFlags & ~INFO_SHARE) : (infoFlags | INFO_SHARE);
+			break;
+		case FIELD_SL:
+			slots = Util::toInt(val);
+			infoFlags = val.empty() ? (infoFlags & ~INFO_SLOTS) : (infoFlags | INFO_SLOTS);
+			break;
+		case FIELD_AW:
+			// AW1 = away, AW2 = extended away; anything else non-empty counts as away
+			away = val.empty() ? 0 : static_cast<uint8_t>(max(1, Util::toInt(val)));
+			break;
+		case FIELD_OTHER:
+			if(val.empty())
+				info.erase(*(short*)name);
+			else
+				info[*(short*)name] = val;
+			break;
+		default:
+			infoFlags = val.empty() ? (infoFlags & ~flagOf(f)) : (infoFlags | flagOf(f));
+			break;
+	}
 }
 
 bool Identity::supports(const string& name) const {
@@ -97,21 +97,27 @@ public:
 		NMDC_PASSIVE = 1 << NMDC_PASSIVE_BIT
 	};
 
-	Identity() : sid(0) { }
-	Identity(const User::Ptr& ptr, uint32_t aSID) : user(ptr), sid(aSID) { }
-	Identity(const Identity& rhs) : Flags(rhs), user(rhs.user), sid(rhs.sid), info(rhs.info) { }
-	Identity& operator=(const Identity& rhs) { Lock l(cs); *static_cast<Flags*>(this) = rhs; user = rhs.user; sid = rhs.sid; info = rhs.info; return *this; }
+	Identity() : sid(0), infoFlags(0), bytesShared(0), slots(0), udpPort(0), away(0) { }
+	Identity(const User::Ptr& ptr, uint32_t aSID) : user(ptr), sid(aSID), infoFlags(0), bytesShared(0), slots(0), udpPort(0), away(0) { }
+	Identity(const Identity& rhs);
+	Identity& operator=(const Identity& rhs);
 
 #define GS(n, x) string get##n() const { return get(x); } void set##n(const string& v) { set(x, v); }
-	GS(Nick, "NI")
 	GS(Description, "DE")
-	GS(Ip, "I4")
-	GS(UdpPort, "U4")
 	GS(Email, "EM")
 	GS(Connection, "CO")
 
+	string getNick() const { FastLock l(cs); return nick; }
+	void setNick(const string& v) { set("NI", v); }
+	string getIp() const { FastLock l(cs); return ip; }
+	void setIp(const string& v) { set("I4", v); }
+	string getUdpPort() const { uint16_t port = getUdpPortNumber(); return port == 0 ? Util::emptyString : Util::toString(port); }
+	void setUdpPort(const string& v) { set("U4", v); }
+
 	void setBytesShared(const string& bs) { set("SS", bs); }
-	int64_t getBytesShared() const { return Util::toInt64(get("SS")); }
+	int64_t getBytesShared() const { FastLock l(cs); return bytesShared; }
+	int getSlots() const { FastLock l(cs); return slots; }
+	uint16_t getUdpPortNumber() const { FastLock l(cs); return udpPort; }
 
 	void setOp(bool op) { set("OP", op ? "1" : Util::emptyString); }
 	void setHub(bool hub) { set("HU", hub ? "1" : Util::emptyString); }
@@ -119,14 +125,14 @@ public:
 	void setHidden(bool hidden) { set("HI", hidden ? "1" : Util::emptyString); }
 	string getTag() const;
 	bool supports(const string& name) const;
-	bool isHub() const { return !get("HU").empty(); }
-	bool isOp() const { return !get("OP").empty(); }
-	bool isRegistered() const { return !get("RG").empty(); }
-	bool isHidden() const { return !get("HI").empty(); }
-	bool isBot() const { return !get("BO").empty(); }
-	bool isAway() const { return !get("AW").empty(); }
-	bool isTcpActive() const { return !getIp().empty() || (user->isSet(User::NMDC) && !user->isSet(User::PASSIVE)); }
-	bool isUdpActive() const { return !getIp().empty() && !getUdpPort().empty(); }
+	bool isHub() const { return hasInfo(INFO_HUB); }
+	bool isOp() const { return hasInfo(INFO_OP); }
+	bool isRegistered() const { return hasInfo(INFO_REGISTERED); }
+	bool isHidden() const { return hasInfo(INFO_HIDDEN); }
+	bool isBot() const { return hasInfo(INFO_BOT); }
+	bool isAway() const { FastLock l(cs); return away != 0; }
+	bool isTcpActive() const { return hasInfo(INFO_IP) || (user->isSet(User::NMDC) && !user->isSet(User::PASSIVE)); }
+	bool isUdpActive() const { FastLock l(cs); return (infoFlags & INFO_IP) != 0 && udpPort != 0; }
 	string get(const char* name) const;
 	void set(const char* name, const string& val);
 	string getSIDString() const { return string((const char*)&sid, 4); }
@@ -136,11 +142,56 @@ public:
 	GETSET(User::Ptr, user, User);
 	GETSET(uint32_t, sid, SID);
 private:
+	/**
+	 * The fields every hub sends for every user live in fixed slots, with flags and numbers
+	 * stored parsed. Everything else goes to the (small) info map. All of it is guarded by
+	 * cs, which is cheap enough for the getters and keeps a 64-bit share size from tearing.
+	 */
+	enum Fields {
+		FIELD_OTHER,
+		FIELD_NI,
+		FIELD_I4,
+		FIELD_U4,
+		FIELD_SS,
+		FIELD_SL,
+		FIELD_AW,
+		FIELD_OP,
+		FIELD_BO,
+		FIELD_HU,
+		FIELD_HI,
+		FIELD_RG
+	};
+
+	enum InfoFlags {
+		INFO_OP = 0x01,
+		INFO_BOT = 0x02,
+		INFO_HUB = 0x04,
+		INFO_HIDDEN = 0x08,
+		INFO_REGISTERED = 0x10,
+		INFO_IP = 0x20,
+		INFO_SHARE = 0x40,
+		INFO_SLOTS = 0x80
+	};
+
+	bool hasInfo(uint32_t aFlag) const { FastLock l(cs); return (infoFlags & aFlag) != 0; }
+
+	static Fields getField(const char* name);
+	static int flagOf(Fields f);
+	void swap(Identity& rhs);
+
 	typedef map<short, string> InfMap;
 	typedef InfMap::iterator InfIter;
 	InfMap info;
-	/** @todo there are probably more threading issues here ...*/
-	mutable CriticalSection cs;
+
+	string nick;
+	string ip;
+	uint32_t infoFlags;
+	int64_t bytesShared;
+	int slots;
+	uint16_t udpPort;
+	uint8_t away;
+
+	mutable FastCriticalSection cs;
 };
 
 class Client;
@@ -267,7 +267,7 @@ public:
 	void get(const string& aType, const string& aName, const int64_t aStart, const int64_t aBytes) { send(AdcCommand(AdcCommand::CMD_GET).addParam(aType).addParam(aName).addParam(Util::toString(aStart)).addParam(Util::toString(aBytes))); }
 	void snd(const string& aType, const string& aName, const int64_t aStart, const int64_t aBytes) { send(AdcCommand(AdcCommand::CMD_SND).addParam(aType).addParam(aName).addParam(Util::toString(aStart)).addParam(Util::toString(aBytes))); }
 
-	void send(const AdcCommand& c) { send(c.toString(0, isSet(FLAG_NMDC))); }
+	void send(const AdcCommand& c) { lastActivity = GET_TICK(); socket->write(c, 0, isSet(FLAG_NMDC)); }
 
 	void supports(const StringList& feat) {
 		string x;
@@ -536,6 +536,19 @@ wstring::size_type Util::findSubString(const wstring& aString, const wstring& aS
 
 int Util::stricmp(const char* a, const char* b) {
 	while(*a) {
+		uint8_t ua = (uint8_t)*a, ub = (uint8_t)*b;
+		if(((ua | ub) & 0x80) == 0) {
+			// Both 7-bit, lower[] agrees with asciiLower[] here so the order is unchanged
+			if(ua != ub) {
+				int la = Text::asciiToLower(ua), lb = Text::asciiToLower(ub);
+				if(la != lb)
+					return la - lb;
+			}
+			++a;
+			++b;
+			continue;
+		}
+
 		wchar_t ca = 0, cb = 0;
 		int na = Text::utf8ToWc(a, ca);
 		int nb = Text::utf8ToWc(b, cb);
@@ -557,6 +570,18 @@ int Util::stricmp(const char* a, const char* b) {
 int Util::strnicmp(const char* a, const char* b, size_t n) {
 	const char* end = a + n;
 	while(*a && a < end) {
+		uint8_t ua = (uint8_t)*a, ub = (uint8_t)*b;
+		if(((ua | ub) & 0x80) == 0) {
+			if(ua != ub) {
+				int la = Text::asciiToLower(ua), lb = Text::asciiToLower(ub);
+				if(la != lb)
+					return la - lb;
+			}
+			++a;
+			++b;
+			continue;
+		}
+
 		wchar_t ca = 0, cb = 0;
 		int na = Text::utf8ToWc(a, ca);
 		int nb = Text::utf8ToWc(b, cb);
@@ -470,6 +470,11 @@ struct noCaseStringHash {
 		size_t x = 0;
 		const char* end = s.data() + s.size();
 		for(const char* str = s.data(); str < end; ) {
+			if(((uint8_t)*str & 0x80) == 0) {
+				x = x*32 - x + (size_t)(uint8_t)Text::asciiToLower(*str);
+				++str;
+				continue;
+			}
 			wchar_t c = 0;
 			int n = Text::utf8ToWc(str, c);
 			if(n < 0) {
@@ -25,20 +25,48 @@
 
 const double ZFilter::MIN_COMPRESSION_LEVEL = 0.9;
 
-ZFilter::ZFilter() : totalIn(0), totalOut(0), compressing(true) {
+#ifdef _DEBUG
+namespace {
+int64_t threadCpuTime() {
+#ifdef _WIN32
+	FILETIME c, e, k, u;
+	GetThreadTimes(GetCurrentThread(), &c, &e, &k, &u);
+	return ((((int64_t)u.dwHighDateTime) << 32) | u.dwLowDateTime) * 100;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+}
+#endif
+
+ZFilter::ZFilter(int aLevel) : totalIn(0), totalOut(0), compressing(true), cpuTime(0) {
 	memset(&zs, 0, sizeof(zs));
 
-	if(deflateInit(&zs, 3) != Z_OK) {
+	if(deflateInit(&zs, aLevel) != Z_OK) {
 		throw Exception(STRING(COMPRESSION_ERROR));
 	}
 }
 
 ZFilter::~ZFilter() {
-	dcdebug("ZFilter end, %ld/%ld = %.04f\n", zs.total_out, zs.total_in, (float)zs.total_out / max((float)zs.total_in, (float)1));
+	dcdebug("ZFilter end, %ld/%ld = %.04f, %.02f ns/byte\n", zs.total_out, zs.total_in, (float)zs.total_out / max((float)zs.total_in, (float)1),
+		(float)cpuTime / max((float)zs.total_in, (float)1));
 	deflateEnd(&zs);
 }
 
 bool ZFilter::operator()(const void* in, size_t& insize, void* out, size_t& outsize) {
+#ifdef _DEBUG
+	int64_t startTime = threadCpuTime();
+	bool ret = compress(in, insize, out, outsize);
+	cpuTime += threadCpuTime() - startTime;
+	return ret;
+#else
+	return compress(in, insize, out, outsize);
+#endif
+}
+
+bool ZFilter::compress(const void* in, size_t& insize, void* out, size_t& outsize) {
 	if(outsize == 0)
 		return false;
 
@@ -46,7 +74,7 @@ bool ZFilter::operator()(const void* in, size_t& insize, void* out, size_t& outs
 	zs.next_out = (Bytef*)out;
 
 	// Check if there's any use compressing; if not, save some cpu...
-	if(compressing && insize > 0 && outsize > 16 && (totalIn > (64*1024)) && ((static_cast<double>(totalOut) / totalIn) > 0.95)) {
+	if(compressing && insize > 0 && outsize > 16 && (totalIn > SAMPLE_SIZE) && ((static_cast<double>(totalOut) / totalIn) > MIN_COMPRESSION_LEVEL)) {
 		zs.avail_in = 0;
 		zs.avail_out = outsize;
 		if(deflateParams(&zs, 0, Z_DEFAULT_STRATEGY) != Z_OK) {
@@ -33,8 +33,10 @@ class ZFilter {
 public:
 	/** Compression will automatically be turned off if below this... */
 	static const double MIN_COMPRESSION_LEVEL;
+	/** Bytes compressed before MIN_COMPRESSION_LEVEL is checked */
+	static const int64_t SAMPLE_SIZE = 64*1024;
 
-	ZFilter();
+	ZFilter(int aLevel = 3);
 	~ZFilter();
 	/**
 	 * Compress data.
@@ -50,6 +52,16 @@ private:
 	int64_t totalIn;
 	int64_t totalOut;
 	bool compressing;
+	/** Thread cpu time spent deflating in ns, only measured in debug builds */
+	int64_t cpuTime;
+
+	bool compress(const void* in, size_t& insize, void* out, size_t& outsize);
+};
+
+/** ZFilter at the fastest level, for large transfers where throughput matters more than ratio */
+class FastZFilter : public ZFilter {
+public:
+	FastZFilter() : ZFilter(Z_BEST_SPEED) { }
 };
 
 class UnZFilter {
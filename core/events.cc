@@ -24,36 +24,135 @@
 #include <utils/utils.h>
 #include <core/log.h>
 #include <core/events.h>
+#include <utils/lock.h>
+#include <time.h>
 
 namespace events {
 
+EventId WINDOW_UPDATED;
+EventId WINDOW_STATUS_UPDATED;
+EventId KEY_PRESSED;
+
+namespace {
+
+/** Milliseconds on the clock m_queueCond waits on, unaffected by
+ * changes to the wall clock. */
+int64_t now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+} // namespace
+
 Manager::Manager():
+    m_queue(0),
+    m_current(0),
     m_running(true)
 {
-    pthread_cond_init(&m_queueCond, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&m_queueCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    WINDOW_UPDATED = id("window updated");
+    WINDOW_STATUS_UPDATED = id("window status updated");
+    KEY_PRESSED = id("key pressed");
 }
 
 void Manager::main_loop()
 {
     do {
-        m_queueMutex.lock();
-        /* wait until there's events to process */
-        pthread_cond_wait(&m_queueCond, m_queueMutex.get_mutex());
-        m_queueMutex.unlock();
-        while(!m_queue.empty()) {
-            emit_event();
+        Event *event = take();
+
+        /* handle the batch in the order it was emitted */
+        while(event) {
+            Event *next = event->next;
+            emit_event(event);
+            delete event;
+            event = next;
         }
     } while(m_running);
 }
 
-void Manager::emit_event()
+Event *Manager::take()
+{
+    m_queueMutex.lock();
+    /* wait until there's events to process */
+    while(true) {
+        int64_t t = now();
+        while(!m_timers.empty() && m_timers.begin()->first <= t) {
+            Event *e = new Event;
+            e->id = m_timers.begin()->second;
+            e->count = 0;
+            enqueue(e);
+            m_timers.erase(m_timers.begin());
+        }
+
+        if(m_queue)
+            break;
+
+        if(m_timers.empty()) {
+            pthread_cond_wait(&m_queueCond, m_queueMutex.get_mutex());
+        } else {
+            int64_t due = m_timers.begin()->first;
+            timespec ts;
+            ts.tv_sec = due / 1000;
+            ts.tv_nsec = (due % 1000) * 1000000;
+            pthread_cond_timedwait(&m_queueCond, m_queueMutex.get_mutex(), &ts);
+        }
+    }
+    m_queueMutex.unlock();
+
+    Event *head = __sync_lock_test_and_set(&m_queue, static_cast<Event*>(0));
+    __sync_synchronize();
+
+    /* the list is newest first */
+    Event *reversed = 0;
+    while(head) {
+        Event *next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+    return reversed;
+}
+
+bool Manager::enqueue(Event *event)
+{
+    Event *head;
+    do {
+        head = m_queue;
+        event->next = head;
+    } while(__sync_val_compare_and_swap(&m_queue, head, event) != head);
+    return !head;
+}
+
+void Manager::push(Event *event)
+{
+    /* the consumer only sleeps on an empty queue */
+    if(enqueue(event)) {
+        m_queueMutex.lock();
+        pthread_cond_signal(&m_queueCond);
+        m_queueMutex.unlock();
+    }
+}
+
+void Manager::emit_event(Event *event)
 {
-    m_args = m_queue[0].second;
+    EventSig *sig;
+    m_eventsMutex.lock();
+    sig = m_signals[event->id];
+    m_eventsMutex.unlock();
+
+    m_current = event;
 
     /* stopping the current event works
      * by throwing StopEvent exception */
     try {
-        (*m_queue[0].first)();
+        (*sig)();
     } catch(StopEvent &e) {
         /* do nothing.. */
     }
@@ -63,66 +162,97 @@ void Manager::emit_event()
         core::Log::get()->log(e.what());
     }
 
-    m_queueMutex.lock();
-    m_queue.erase(m_queue.begin());
-    m_queueMutex.unlock();
+    m_current = 0;
 }
 
 void Manager::create_event(const std::string &event)
     throw(std::logic_error)
 {
+    utils::Lock l(m_eventsMutex);
     if(m_events.find(event) != m_events.end())
         throw std::logic_error("Event already exists");
 
-    m_events[event] = new EventSig();
+    m_events[event] = m_signals.size();
+    m_signals.push_back(new EventSig());
+}
+
+EventId Manager::id(const std::string &event)
+{
+    utils::Lock l(m_eventsMutex);
+    EventMap::iterator i = m_events.find(event);
+    if(i != m_events.end())
+        return i->second;
+
+    EventId id = m_signals.size();
+    m_events[event] = id;
+    m_signals.push_back(new EventSig());
+    return id;
 }
 
 boost::signals::connection
 Manager::add_listener(const std::string &event, EventFunc &func, Priority priority)
     throw(std::logic_error)
 {
-    if(m_events.find(event) == m_events.end()) {
-        //throw std::logic_error("Event doesn't exist: " + event);
-        m_events[event] = new EventSig();
-    }
+    EventId event_id = id(event);
 
-    return m_events[event]->connect(priority, func);
+    utils::Lock l(m_eventsMutex);
+    return m_signals[event_id]->connect(priority, func);
 }
 
-
 void Manager::emit(const std::string &event, boost::any a1,
         boost::any a2, boost::any a3,
         boost::any a4, boost::any a5)
 {
-    if(m_events.find(event) == m_events.end())
-        return;
-
-    AnyList args;
-    if(!a1.empty())
-        args.push_back(a1);
-    if(!a2.empty())
-        args.push_back(a2);
-    if(!a3.empty())
-        args.push_back(a3);
-    if(!a4.empty())
-        args.push_back(a4);
-    if(!a5.empty())
-        args.push_back(a5);
+    EventId event_id;
+    {
+        utils::Lock l(m_eventsMutex);
+        EventMap::iterator i = m_events.find(event);
+        if(i == m_events.end())
+            return;
+        event_id = i->second;
+    }
 
-    m_queueMutex.lock();
-    m_queue.push_back(std::make_pair(m_events[event], args));
+    emit(event_id, a1, a2, a3, a4, a5);
+}
 
-    system(std::string("echo " + event + " >>emit").c_str());
-    m_queueMutex.unlock();
+void Manager::emit(EventId event, boost::any a1,
+        boost::any a2, boost::any a3,
+        boost::any a4, boost::any a5)
+{
+    Event *e = new Event;
+    e->id = event;
+    e->count = 0;
+
+    boost::any *args[Event::MAX_ARGS] = { &a1, &a2, &a3, &a4, &a5 };
+    for(unsigned int i = 0; i < Event::MAX_ARGS; ++i) {
+        if(!args[i]->empty())
+            e->args[e->count++].swap(*args[i]);
+    }
 
-    /* signal other thread there's data available */
+    push(e);
+}
+
+void Manager::emit_later(EventId event, unsigned int delay)
+{
+    utils::Lock l(m_queueMutex);
+    m_timers.insert(std::make_pair(now() + delay, event));
+    /* the main loop may need to wake up earlier */
     pthread_cond_signal(&m_queueCond);
 }
 
 Manager::~Manager()
 {
+    Event *event = m_queue;
+    while(event) {
+        Event *next = event->next;
+        delete event;
+        event = next;
+    }
+
+    for(std::vector<EventSig*>::iterator i = m_signals.begin(); i != m_signals.end(); ++i)
+        delete *i;
+
     pthread_cond_destroy(&m_queueCond);
 }
 
 } // namespace events
-
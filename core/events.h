@@ -26,6 +26,7 @@
 
 #include <pthread.h>
 #include <list>
+#include <map>
 #include <vector>
 #include <functional>
 #include <boost/signal.hpp>
@@ -37,10 +38,16 @@
 
 namespace events {
 
-typedef std::vector<boost::any> AnyList;
 typedef std::function<void ()> EventFunc;
 typedef boost::signal<void ()> EventSig;
-typedef std::map<std::string, EventSig*> EventMap;
+/** Event names are interned to these at registration. */
+typedef unsigned int EventId;
+
+/** Ids of the events emitted on every key press and list change,
+ * interned when the Manager is created. */
+extern EventId WINDOW_UPDATED;
+extern EventId WINDOW_STATUS_UPDATED;
+extern EventId KEY_PRESSED;
 
 /** Event priorities. */
 enum Priority {
@@ -51,6 +58,16 @@ enum Priority {
 
 class StopEvent { };
 
+/** A queued event with its arguments. */
+struct Event {
+    enum { MAX_ARGS = 5 };
+
+    EventId id;
+    unsigned int count;
+    boost::any args[MAX_ARGS];
+    Event *next;
+};
+
 class Manager:
     public utils::Instance<events::Manager>
 {
@@ -61,6 +78,10 @@ public:
      * @throw std::logic_error If the event already exists. */
     void create_event(const std::string &event) throw(std::logic_error);
 
+    /** Get the id of an event, creating the event if needed.
+     * Emitting by id skips the name lookup. */
+    EventId id(const std::string &event);
+
     /** Add a listener for a specific event.
      * @throw std::logic_error If event is not created. */
     boost::signals::connection add_listener(const std::string &event,
@@ -72,15 +93,28 @@ public:
             boost::any a2=boost::any(), boost::any a3=boost::any(),
             boost::any a4=boost::any(), boost::any a5=boost::any());
 
+    /** Emit the event with id \c event. Safe to call from any thread. */
+    void emit(EventId event, boost::any a1=boost::any(),
+            boost::any a2=boost::any(), boost::any a3=boost::any(),
+            boost::any a4=boost::any(), boost::any a5=boost::any());
+
+    /** Emit the event with id \c event without arguments
+     * after \c delay milliseconds. */
+    void emit_later(EventId event, unsigned int delay);
+
     /** Get the nth argument of current event. */
     template <class T>
-    T arg(unsigned int n) { return boost::any_cast<T>(m_args[n]); }
+    T arg(unsigned int n) { return boost::any_cast<T>(arg(n)); }
 
     /** Return a reference to nth argument. */
-    boost::any& arg(unsigned int n) { return m_args[n]; }
+    boost::any& arg(unsigned int n) {
+        if(!m_current || n >= m_current->count)
+            throw boost::bad_any_cast();
+        return m_current->args[n];
+    }
 
     /** Return the number of arguments. */
-    unsigned int args() { return m_args.size(); }
+    unsigned int args() { return m_current ? m_current->count : 0; }
 
     /** Stop handling current event. */
     void stop() { throw StopEvent(); }
@@ -93,14 +127,29 @@ public:
 
     ~Manager();
 private:
-    void emit_event();
+    typedef std::map<std::string, EventId> EventMap;
+    typedef std::multimap<int64_t, EventId> TimerMap;
+
+    bool enqueue(Event *event);
+    void push(Event *event);
+    Event *take();
+    void emit_event(Event *event);
 
+    /** Name -> id, and id -> signal */
     EventMap m_events;
-    std::vector<std::pair<EventSig*, AnyList> > m_queue;
+    std::vector<EventSig*> m_signals;
+    utils::Mutex m_eventsMutex;
+
+    /** Emitted events, newest first. Producers push without locking,
+     * main_loop takes the whole list at once. */
+    Event *volatile m_queue;
     utils::Mutex m_queueMutex;
-    AnyList m_args;
-    bool m_running;
     pthread_cond_t m_queueCond;
+    /** Delayed events by due time, guarded by m_queueMutex */
+    TimerMap m_timers;
+
+    Event *m_current;
+    bool m_running;
 };
 
 inline
@@ -135,6 +184,20 @@ void emit(const std::string &event, boost::any a1=boost::any(),
     events::Manager::get()->emit(event, a1, a2, a3, a4, a5);
 }
 
+inline
+void emit(EventId event, boost::any a1=boost::any(),
+        boost::any a2=boost::any(), boost::any a3=boost::any(),
+        boost::any a4=boost::any(), boost::any a5=boost::any())
+{
+    events::Manager::get()->emit(event, a1, a2, a3, a4, a5);
+}
+
+inline
+EventId id(const std::string &event)
+{
+    return events::Manager::get()->id(event);
+}
+
 template <class T>
 T arg(unsigned int n) {
     return events::Manager::get()->arg<T>(n);
@@ -29,7 +29,10 @@
 
 namespace core {
 
-Log::Log()
+Log::Log():
+    m_time(0),
+    m_flushPending(false),
+    m_flushEvent(events::id("log flush"))
 {
     core::Settings *settings = core::Settings::get();
 
@@ -39,6 +42,8 @@ Log::Log()
 
     m_realFilename = utils::time_to_string(m_logFilename);
     m_file.open(m_realFilename.c_str(), std::ios::out | std::ios::app);
+
+    events::add_listener("log flush", std::bind(&Log::flush, this));
 }
 
 void Log::update_config()
@@ -47,6 +52,9 @@ void Log::update_config()
     m_logFilename = settings->find("log_filename", "%Y-%m-%d");
     m_logToFile = settings->find_bool("log_to_file", true);
     m_logTimestamp = settings->find("log_timestamp", "%H:%M:%S");
+
+    utils::Lock lock(m_mutex);
+    m_time = 0;
 }
 
 void Log::log(const std::string &message, MessageType mt /* = MT_MSG */)
@@ -54,25 +62,44 @@ void Log::log(const std::string &message, MessageType mt /* = MT_MSG */)
     if(mt == MT_DEBUG && !LOG_DEBUG)
         return;
 
+    bool schedule = false;
     {
         utils::Lock lock(m_mutex);
         if(m_logToFile) {
-            std::string temp = m_realFilename;
-            m_realFilename = utils::time_to_string(m_logFilename);
+            time_t now = time(0);
+            if(now != m_time) {
+                m_time = now;
+                m_timestamp = utils::time_to_string(m_logTimestamp, now);
 
-            /* day or format string changed? */
-            if(temp != m_realFilename) {
-                m_file.close();
-                m_file.open(m_realFilename.c_str(), std::ios::out | std::ios::app);
+                std::string temp = m_realFilename;
+                m_realFilename = utils::time_to_string(m_logFilename, now);
+
+                /* day or format string changed? */
+                if(temp != m_realFilename) {
+                    m_file.close();
+                    m_file.open(m_realFilename.c_str(), std::ios::out | std::ios::app);
+                }
             }
-            m_file << utils::time_to_string(m_logTimestamp) 
-                   << " " << message << std::endl;
+            m_file << m_timestamp << " " << message << '\n';
+
+            schedule = !m_flushPending;
+            m_flushPending = true;
         }
     }
 
+    if(schedule)
+        events::Manager::get()->emit_later(m_flushEvent, 1000);
+
     m_logSig(message, mt);
 }
 
+void Log::flush()
+{
+    utils::Lock lock(m_mutex);
+    m_file.flush();
+    m_flushPending = false;
+}
+
 Log::~Log()
 {
     m_file.close();
@@ -28,9 +28,11 @@
 #include <vector>
 #include <utils/instance.h>
 #include <utils/mutex.h>
+#include <core/events.h>
 #include <boost/signals.hpp>
 #include <functional>
 #include <fstream>
+#include <ctime>
 
 namespace core {
 
@@ -48,6 +50,9 @@ enum MessageType {
  *  - log_filename with default value of "%Y-%m-%d"
  *  - log_to_file with default value of "true"
  *  - log_timestamp with default value of "%H:%M:%S"
+ *
+ * The file is flushed a second after the first unflushed message
+ * is logged, and when the log is closed.
  */
 class Log:
     public utils::Instance<core::Log>
@@ -72,11 +77,18 @@ private:
     /** Called when settings are changed. */
     void update_config();
 
+    /** Write the buffered lines to the file. */
+    void flush();
+
     std::ofstream m_file; //!< Output file
     std::string m_logFilename; //!< Format of the log file name
     std::string m_realFilename; //!< The real file name
     std::string m_logTimestamp; //!< Timestamp format in log file
+    std::string m_timestamp; //!< The formatted timestamp of m_time
+    time_t m_time; //!< When the names were last formatted
     bool m_logToFile; //!< Whether to log to file
+    bool m_flushPending; //!< Whether m_flushEvent is scheduled
+    events::EventId m_flushEvent;
     boost::signal<void (const std::string &, MessageType)> m_logSig;
 
     utils::Mutex m_mutex;
@@ -76,6 +76,10 @@ void Manager::start_client()
     if(!core::Settings::get()->exists("command_char"))
         core::Settings::get()->set("command_char", "/");
 
+    // block urls by default
+    if(!core::Settings::get()->exists("block_messages"))
+        core::Settings::get()->set("block_messages", "http://;www.");
+
     core::Log::get()->log("Starting the client...");
     ResourceManager::newInstance();
     SettingsManager::newInstance();
@@ -39,12 +39,22 @@ Properties::Properties():
 
 }
 
+Properties::Value Properties::parse(const std::string &text)
+{
+    Value value;
+    value.text = text;
+    value.number = utils::to<int>(text);
+    value.flag = text == "true";
+    return value;
+}
+
 void Properties::load(std::istream &in)
 {
     std::string key, value;
     key.reserve(20);
 
-    m_properties.clear();
+    Values old;
+    old.swap(m_properties);
     for(std::string line; std::getline(in, line);) {
         std::string::size_type comment = line.find('#');
         std::string::size_type space = line.find_last_not_of(" \t\n");
@@ -61,8 +71,22 @@ void Properties::load(std::istream &in)
             continue;
 
         value = line.substr(valuestart);
-        m_properties[key] = value;
+        m_properties[key] = parse(value);
+    }
+
+    StringVector changed;
+    for(Values::const_iterator i=m_properties.begin(); i!=m_properties.end(); ++i) {
+        Values::const_iterator j = old.find(i->first);
+        if(j == old.end() || j->second.text != i->second.text)
+            changed.push_back(i->first);
+    }
+    for(Values::const_iterator i=old.begin(); i!=old.end(); ++i) {
+        if(m_properties.find(i->first) == m_properties.end())
+            changed.push_back(i->first);
     }
+
+    if(!changed.empty())
+        properties_changed(changed);
 }
 
 void Properties::load()
@@ -85,7 +109,7 @@ void Properties::save()
     if(!newfile || !oldfile)
         return;
 
-    HashMap temp = m_properties;
+    HashMap temp = get_properties();
     for(std::string line; std::getline(oldfile, line);) {
         std::string::size_type comment = line.find('#');
         std::string::size_type space = line.find_last_not_of(" \t\n");
@@ -103,7 +127,8 @@ void Properties::save()
         if(valuestart == std::string::npos)
             continue;
 
-        newfile << key << " = " << m_properties[key] << std::endl; 
+        Values::const_iterator it = m_properties.find(key);
+        newfile << key << " = " << (it != m_properties.end() ? it->second.text : "") << std::endl;
         temp.erase(key);
     }
     oldfile.close();
@@ -117,27 +142,33 @@ void Properties::save()
     std::remove(oldfilename.c_str());
 }
 
+HashMap Properties::get_properties() const
+{
+    HashMap properties;
+    for(Values::const_iterator i=m_properties.begin(); i!=m_properties.end(); ++i)
+        properties.insert(properties.end(), std::make_pair(i->first, i->second.text));
+    return properties;
+}
+
 std::string Properties::find(const std::string &key, std::string def)
     const
 {
-    HashMap::const_iterator it = m_properties.find(key);
-    return (it == m_properties.end() ? def : it->second);
+    Values::const_iterator it = m_properties.find(key);
+    return (it == m_properties.end() ? def : it->second.text);
 }
 
 int Properties::find_int(const std::string &key, int def)
     const
 {
-    if(!exists(key))
-        return def;
-    return utils::to<int>(find(key));
+    Values::const_iterator it = m_properties.find(key);
+    return (it == m_properties.end() ? def : it->second.number);
 }
 
 bool Properties::find_bool(const std::string &key, bool def)
     const
 {
-    if(!exists(key))
-        return def;
-    return find(key) == "true" ? true : false;
+    Values::const_iterator it = m_properties.find(key);
+    return (it == m_properties.end() ? def : it->second.flag);
 }
 
 std::vector<std::string> Properties::find_vector(const std::string &key)
@@ -150,12 +181,16 @@ std::vector<std::string> Properties::find_vector(const std::string &key)
 
 void Properties::set(const std::string &key, const std::string &value)
 {
-    m_properties[key] = value;
+    Values::iterator it = m_properties.find(key);
+    if(it != m_properties.end() && it->second.text == value)
+        return;
+
+    m_properties[key] = parse(value);
     if(m_autosave)
         save();
     else
         m_changed = true;
-    properties_changed();
+    properties_changed(StringVector(1, key));
 }
 
 void Properties::set(const std::string &key, const char *value)
@@ -109,19 +109,30 @@ public:
      * @return True if the key is set */
     bool exists(const std::string &key) const { return m_properties.find(key) != m_properties.end(); }
 
-    /** Called when a value is changed. */
-    virtual void properties_changed() { }
+    /** Called when values are changed by set() or load().
+     * @param keys The keys whose values changed */
+    virtual void properties_changed(const StringVector &keys) { }
 
     /** Returns the map containing all properties and values. */
-    HashMap get_properties() { return m_properties; }
+    HashMap get_properties() const;
 
     /** Destructor. Saves the file. */
     virtual ~Properties();
 private:
+    /** A value, parsed when it is set so that finding it doesn't parse */
+    struct Value {
+        std::string text;
+        int number;
+        bool flag;
+    };
+    typedef std::map<std::string, Value> Values;
+
+    static Value parse(const std::string &text);
+
     bool m_autosave;
     bool m_changed;
     std::string m_filename;
-    HashMap m_properties;
+    Values m_properties;
     const char *m_vector_separator;
 };
 
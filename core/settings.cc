@@ -27,6 +27,7 @@
 #include <fstream>
 #include <sstream>
 #include <iterator>
+#include <algorithm>
 
 namespace core {
 
@@ -41,9 +42,18 @@ void Settings::read(const std::string &filename)
     this->set_autosave(this->find_bool("save_on_edit", false));
 }
 
-void Settings::properties_changed()
+void Settings::properties_changed(const StringVector &keys)
 {
+    /* a listener may set a value too */
+    const StringVector *outer = m_changedKeys;
+    m_changedKeys = &keys;
     m_listeners();
+    m_changedKeys = outer;
+}
+
+bool Settings::changed(const std::string &key) const
+{
+    return !m_changedKeys || std::find(m_changedKeys->begin(), m_changedKeys->end(), key) != m_changedKeys->end();
 }
 
 } // namespace core
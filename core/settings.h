@@ -37,13 +37,19 @@ class Settings:
     public utils::Instance<core::Settings> 
 {
 public:
-    Settings() { }
-    void properties_changed();
+    Settings(): m_changedKeys(0) { }
+    void properties_changed(const StringVector &keys);
     /** Read settings from a file.  */
     void read(const std::string &file);
     boost::signals::connection add_listener(std::function<void ()> slot) { return m_listeners.connect(slot); }
+
+    /** Returns true if \c key is among the changed keys when called
+     * from a listener, so listeners can skip work for other keys.
+     * Returns always true outside listeners. */
+    bool changed(const std::string &key) const;
 private:
     boost::signal<void ()> m_listeners;
+    const StringVector *m_changedKeys; //!< The changed keys while the listeners run
 };
 
 } // namespace core
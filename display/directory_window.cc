@@ -27,6 +27,7 @@
 #include <input/manager.h>
 #include <utils/lock.h>
 #include <core/log.h>
+#include <core/events.h>
 #include <utils/algorithm.h>
 
 namespace display {
@@ -83,8 +84,13 @@ void DirectoryWindow::change_focus()
     }
 }
 
-void DirectoryWindow::handle(int key)
+void DirectoryWindow::handle(wint_t key)
 {
+    if(m_insertMode) {
+        handle_input(key);
+        return;
+    }
+
     if(m_bindings.find(key) != m_bindings.end()) {
         m_bindings[key]();
         return;
@@ -112,6 +118,32 @@ void DirectoryWindow::handle(int key)
     }
 }
 
+void DirectoryWindow::handle_input(wint_t key)
+{
+    if(key == '\n') {
+        bool empty = m_input.str().empty();
+        m_input.pressed(key);
+        m_insertMode = false;
+        set_prompt();
+        if(empty)
+            handle_line(std::string());
+    }
+    else if(key == KEY_CANCEL_INPUT) {
+        m_input.assign(std::string());
+        m_input.set_pos(0);
+        m_insertMode = false;
+        set_prompt();
+    }
+    else if(key >= 0x20 && key < 0xFF) {
+        m_input.key_insert(key);
+    }
+    else {
+        /* backspace, arrow keys.. */
+        m_input.pressed(key);
+    }
+    events::emit(events::WINDOW_UPDATED, dynamic_cast<display::Window*>(this));
+}
+
 void DirectoryWindow::set_current(Directory *directory)
 {
     m_current = directory;
@@ -42,6 +42,8 @@ const unsigned int DIRVIEW_DEFAULTSIZE = 25;
 const unsigned int DIRVIEW_MINSIZE = 5;
 /** The minimum size of file list view. */
 const unsigned int FILEVIEW_MINSIZE = 5;
+/** Leaves insert mode without using the typed line (^G). */
+const wint_t KEY_CANCEL_INPUT = 0x07;
 
 /** A directory tree window. */
 class DirectoryWindow:
@@ -53,7 +55,7 @@ public:
     /** Default constructor. */
     DirectoryWindow();
 
-    virtual void handle(int key);
+    virtual void handle(wint_t key);
 
     /** Redraw the window. */
     virtual void redraw();
@@ -62,7 +64,7 @@ public:
 
     virtual void create_list() = 0;
 
-    void open_item();
+    virtual void open_item();
 
     void set_current(Directory *directory);
 
@@ -72,6 +74,10 @@ public:
     /** If m_viewType is DIRSANDFILES, changes focus between directory list and file list. */
     void change_focus();
 
+    /** Edit the input line while in insert mode. Enter passes an empty
+     * line to handle_line(), others get there through the line handler. */
+    void handle_input(wint_t key);
+
     /** Destructor. */
     virtual ~DirectoryWindow();
 
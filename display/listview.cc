@@ -39,9 +39,9 @@
 namespace display {
 
 ListView::ListView():
-    m_rowCount(0),
     m_currentItem(std::numeric_limits<int>::min()),
-    m_infoboxHeight(4)
+    m_infoboxHeight(4),
+    m_renumberFrom(0)
 {
     m_insertMode = false;
 
@@ -107,42 +107,160 @@ void ListView::resize()
 
 int ListView::insert_row()
 {
-    std::for_each(m_columns.begin(), m_columns.end(),
-        std::mem_fun(&Column::insert_row));
-    return m_rowCount++;
+    Row *row = new Row();
+    row->cells.resize(m_columns.size());
+    row->index = m_rows.size();
+    m_rows.push_back(row);
+    return row->index;
+}
+
+int ListView::insert_row(unsigned int pos)
+{
+    unsigned int rows = m_rows.size();
+    if(pos >= rows)
+        return insert_row();
+
+    Row *row = new Row();
+    row->cells.resize(m_columns.size());
+    row->index = pos;
+    m_rows.insert(m_rows.begin()+pos, row);
+    m_renumberFrom = std::min(m_renumberFrom, pos);
+
+    if(m_currentItem >= static_cast<int>(pos) && m_currentItem < static_cast<int>(rows))
+        m_currentItem++;
+    return pos;
+}
+
+unsigned int ListView::position(Row *row)
+{
+    if(row->index >= m_renumberFrom) {
+        for(unsigned int i = m_renumberFrom; i < m_rows.size(); ++i)
+            m_rows[i]->index = i;
+        m_renumberFrom = m_rows.size();
+    }
+    return row->index;
+}
+
+ListView::Index &ListView::get_index(unsigned int column)
+{
+    if(m_indexes.size() <= column)
+        m_indexes.resize(column+1, 0);
+
+    if(!m_indexes[column]) {
+        m_indexes[column] = new Index();
+        for(Rows::iterator i = m_rows.begin(); i != m_rows.end(); ++i)
+            index_cell(column, *i);
+    }
+    return *m_indexes[column];
+}
+
+void ListView::index_cell(unsigned int column, Row *row)
+{
+    if(column < row->cells.size() && !row->cells[column].empty())
+        m_indexes[column]->insert(std::make_pair(row->cells[column], row));
+}
+
+void ListView::unindex_cell(unsigned int column, Row *row)
+{
+    if(column >= row->cells.size() || row->cells[column].empty())
+        return;
+
+    Index &index = *m_indexes[column];
+    std::pair<Index::iterator, Index::iterator> range = index.equal_range(row->cells[column]);
+    for(Index::iterator i = range.first; i != range.second; ++i) {
+        if(i->second == row) {
+            index.erase(i);
+            return;
+        }
+    }
+}
+
+int ListView::find_row(int column, const std::string &content)
+    throw(std::out_of_range)
+{
+    m_columns.at(column);
+
+    if(content.empty()) {
+        for(unsigned int i = 0; i < m_rows.size(); ++i) {
+            if(m_rows[i]->cells.size() <= static_cast<unsigned int>(column) || m_rows[i]->cells[column].empty())
+                return i;
+        }
+        return -1;
+    }
+
+    /* the first of equal rows, like a linear search would find */
+    Index &index = get_index(column);
+    std::pair<Index::iterator, Index::iterator> range = index.equal_range(content);
+    int row = -1;
+    for(Index::iterator i = range.first; i != range.second; ++i) {
+        int pos = position(i->second);
+        if(row == -1 || pos < row)
+            row = pos;
+    }
+    return row;
 }
 
 void ListView::delete_row(int column, const std::string &text)
 {
-    int row = m_columns.at(column)->find_row(text);
-    if(row >= m_rowCount)
+    int rows = m_rows.size();
+    int pos = find_row(column, text);
+    if(pos == -1)
         return;
 
-    std::for_each(m_columns.begin(), m_columns.end(),
-        std::bind2nd(
-            std::mem_fun(&Column::delete_row),
-            row));
+    Row *row = m_rows[pos];
+    for(unsigned int i = 0; i < m_indexes.size(); ++i) {
+        if(m_indexes[i])
+            unindex_cell(i, row);
+    }
 
-    if(row == m_rowCount-1) {
-        m_currentItem--;}
+    m_rows.erase(m_rows.begin()+pos);
+    delete row;
+    m_renumberFrom = std::min<unsigned int>(m_renumberFrom, pos);
 
-    m_rowCount--;
+    if(pos == rows-1) {
+        m_currentItem--;
+    }
 }
 
 void ListView::delete_all()
 {
-    std::for_each(m_columns.begin(), m_columns.end(),
-        std::mem_fun(&Column::clear));
-    m_rowCount = 0;
-    events::emit("window updated", this);
+    std::for_each(m_rows.begin(), m_rows.end(), utils::delete_functor<Row>());
+    m_rows.clear();
+    std::for_each(m_indexes.begin(), m_indexes.end(), utils::delete_functor<Index>());
+    m_indexes.clear();
+    m_renumberFrom = 0;
+    events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ListView::set_text(int column, int row, const std::string &text)
     throw(std::out_of_range)
 {
-    Column *c = m_columns.at(column);
-    c->set_text(row, text);
-    events::emit("window updated", this);
+    set_cell(column, row, text);
+    events::emit(events::WINDOW_UPDATED, this);
+}
+
+void ListView::set_cell(int column, int row, const std::string &text)
+    throw(std::out_of_range)
+{
+    m_columns.at(column);
+    Row *r = m_rows.at(row);
+    if(r->cells.size() <= static_cast<unsigned int>(column))
+        r->cells.resize(m_columns.size());
+
+    bool indexed = static_cast<unsigned int>(column) < m_indexes.size() && m_indexes[column];
+    if(indexed)
+        unindex_cell(column, r);
+    r->cells[column] = text;
+    if(indexed)
+        index_cell(column, r);
+}
+
+std::string ListView::get_text(int column, int row)
+    throw(std::out_of_range)
+{
+    m_columns.at(column);
+    Row *r = m_rows.at(row);
+    return static_cast<unsigned int>(column) < r->cells.size() ? r->cells[column] : std::string();
 }
 
 void ListView::handle(wint_t key)
@@ -169,15 +287,16 @@ void ListView::handle(wint_t key)
 void ListView::scroll_list(int items)
 {
     m_currentItem += items;
-    events::emit("window updated", this);
+    events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ListView::redraw()
 {
-    if(m_currentItem >= static_cast<int>(m_rowCount) || m_currentItem == std::numeric_limits<int>::min())
+    int rows = m_rows.size();
+    if(m_currentItem >= rows || m_currentItem == std::numeric_limits<int>::min())
         m_currentItem = 0;
     else if(m_currentItem < 0)
-        m_currentItem = m_rowCount-1;
+        m_currentItem = rows-1;
 
     erase();
 
@@ -192,25 +311,27 @@ void ListView::redraw()
     }
     clear_flags();
 
-    if(m_rowCount == 0) {
+    if(rows == 0) {
         refresh();
         return;
     }
 
+    /* only the rows around the selected one are drawn */
     typedef std::pair<unsigned int, unsigned int> Range;
-    Range range = rak::advance_bidirectional<unsigned int>(0, m_currentItem, m_rowCount, get_height()-1-m_infoboxHeight);
+    Range range = rak::advance_bidirectional<unsigned int>(0, m_currentItem, rows, get_height()-1-m_infoboxHeight);
 
     while(range.first != range.second) {
         x = 0;
         y++;
 
+        const std::vector<std::string> &cells = m_rows[range.first]->cells;
         for(unsigned int i=0; i<m_columns.size(); ++i) {
             Column *c = m_columns[i];
             if(c->is_hidden()) {
                 continue;
             }
 
-            std::string text = c->get_text(range.first);
+            std::string text = i < cells.size() ? cells[i] : std::string();
             unsigned int width = c->get_real_width();
             if(strings::length(text) >= width)
                 text = text.substr(0, width-1);
@@ -234,6 +355,8 @@ void ListView::redraw()
 ListView::~ListView()
 {
     std::for_each(m_columns.begin(), m_columns.end(), utils::delete_functor<Column>());
+    std::for_each(m_rows.begin(), m_rows.end(), utils::delete_functor<Row>());
+    std::for_each(m_indexes.begin(), m_indexes.end(), utils::delete_functor<Index>());
 }
 
 } // namespace display
@@ -27,6 +27,7 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
 #include <utils/utils.h>
 #include <utils/mutex.h>
 #include <display/window.h>
@@ -39,7 +40,7 @@ public:
     friend class ListView;
 
     Column(const std::string &name, int minWidth, int preferredWidth, int maxWidth):
-        m_name(name), m_rows(), m_minWidth(minWidth),
+        m_name(name), m_minWidth(minWidth),
         m_preferredWidth(preferredWidth),
         m_maxWidth(maxWidth), m_realWidth(0), m_hidden(false)
          { }
@@ -59,27 +60,12 @@ public:
     int get_real_width() const { return m_realWidth; }
     void reset_width() { m_realWidth = m_minWidth; }
 
-    void insert_row() { m_rows.push_back(""); }
-
-    int find_row(const std::string &content) {
-        std::vector<std::string>::iterator it = std::find(m_rows.begin(), m_rows.end(), content);
-        return std::distance(m_rows.begin(), it);
-    }
-
-    void delete_row(int row) { m_rows.erase(m_rows.begin()+row); }
-
-    void set_text(int row, const std::string &text) throw(std::out_of_range) { m_rows.at(row) = text; }
-    std::string get_text(int row) { return m_rows.at(row); }
-
-    void clear() { m_rows.clear(); }
-
     /** Used to calculate the total width of all columns. */
     static int calc_width(int width, Column *column) {
         return width + column->m_realWidth;
     }
 private:
     std::string m_name;
-    std::vector<std::string> m_rows;
     int m_minWidth;
     int m_preferredWidth;
     int m_maxWidth;
@@ -103,11 +89,14 @@ public:
      * @return The index of the new row. */
     int insert_row();
 
-    /** Find a row by its content. Returns -1 if row is not found. */
-    int find_row(int column, const std::string &content) throw(std::out_of_range) {
-        int row = m_columns.at(column)->find_row(content);
-        return row >= m_rowCount ? -1 : row;
-    }
+    /** Insert a new row before row \c pos, the selection stays
+     * on the same row.
+     * @return The index of the new row. */
+    int insert_row(unsigned int pos);
+
+    /** Find a row by its content. Returns -1 if row is not found.
+     * The first lookup in a column indexes it, later ones are hash lookups. */
+    int find_row(int column, const std::string &content) throw(std::out_of_range);
 
     /** Delete row where \c column contains \c text. */
     void delete_row(int column, const std::string &text);
@@ -129,11 +118,10 @@ public:
     void set_text(int column, int row, int i) throw(std::out_of_range)
         { set_text(column, row, utils::to_string(i)); }
 
-    std::string get_text(int column, int row) throw(std::out_of_range)
-        { return m_columns.at(column)->get_text(row); }
+    std::string get_text(int column, int row) throw(std::out_of_range);
 
     /** Returns the number of rows in the window. */
-    unsigned int get_size() { return m_rowCount; }
+    unsigned int get_size() { return m_rows.size(); }
 
     /** Redraw the window. */
     virtual void redraw();
@@ -155,11 +143,37 @@ public:
     virtual ~ListView();
     typedef std::vector<Column*> Columns;
 protected:
-    int m_rowCount;
     Columns m_columns;
     utils::Mutex m_itemLock;
     int m_currentItem;
     unsigned int m_infoboxHeight;
+
+    /** Like set_text() but doesn't emit "window updated", for
+     * filling many cells before a single update.
+     * @throw std::out_of_range if column or row is invalid. */
+    void set_cell(int column, int row, const std::string &text) throw(std::out_of_range);
+private:
+    /** A row, cells are stored in column order. */
+    struct Row {
+        std::vector<std::string> cells;
+        unsigned int index; //!< Position in m_rows, stale if >= m_renumberFrom
+    };
+
+    typedef std::vector<Row*> Rows;
+    /** Cell content -> rows, empty cells are not indexed */
+    typedef std::unordered_multimap<std::string, Row*> Index;
+
+    /** Get the position of a row, renumbering rows moved by deletes if needed. */
+    unsigned int position(Row *row);
+
+    /** Get the index of a column, creating it on first use. */
+    Index &get_index(unsigned int column);
+    void index_cell(unsigned int column, Row *row);
+    void unindex_cell(unsigned int column, Row *row);
+
+    Rows m_rows;
+    std::vector<Index*> m_indexes; //!< Per column, NULL if not indexed
+    unsigned int m_renumberFrom; //!< Rows from here on may have a stale index
 };
 
 } // namespace display
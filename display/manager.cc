@@ -38,7 +38,8 @@ Manager::Manager():
     m_windows(new Windows()),
     m_current(m_windows->end()),
     m_statusbar(display::StatusBar::create()),
-    m_altPressed(false)
+    m_altPressed(false),
+    m_dirty(DIRTY_ALL)
 {
     events::add_listener("key pressed",
             std::bind(&display::Window::handle,
@@ -83,6 +84,7 @@ void Manager::set_current(Windows::iterator current)
     m_current = current;
     (*m_current)->set_state(STATE_IS_ACTIVE);
     (*m_current)->refresh();
+    m_dirty = DIRTY_ALL;
 
     events::emit("window status updated", *current, STATE_IS_ACTIVE);
     events::emit("window updated", *current);
@@ -128,21 +130,34 @@ void Manager::redraw()
 {
     if(display::Screen::is_resized()) {
         resize();
+        m_dirty = DIRTY_ALL;
     }
 
-    (*m_current)->draw();
-    m_statusbar->redraw();
+    if(!m_dirty)
+        return;
+
+    if(m_dirty & DIRTY_WINDOW)
+        (*m_current)->draw();
+    if(m_dirty & DIRTY_STATUSBAR)
+        m_statusbar->redraw();
 
     if((*m_current)->insert_mode()) {
-        m_inputWindow.set_prompt((*m_current)->get_prompt());
-        m_inputWindow.redraw();
-        curs_set((*m_current)->insert_mode() ? 1 : 0);
+        if(m_dirty & DIRTY_INPUT) {
+            m_inputWindow.set_prompt((*m_current)->get_prompt());
+            m_inputWindow.redraw();
+        }
+        else {
+            /* refreshed last so the cursor stays on the input line */
+            m_inputWindow.refresh();
+        }
+        curs_set(1);
     }
-    else {
+    else if(m_dirty & DIRTY_INPUT) {
         m_inputWindow.erase();
         m_inputWindow.refresh();
-        curs_set((*m_current)->insert_mode() ? 1 : 0);
+        curs_set(0);
     }
+    m_dirty = 0;
     display::Screen::do_update();
 }
 
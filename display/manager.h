@@ -47,12 +47,23 @@ class Manager:
     public utils::Instance<display::Manager>
 {
 public:
+    /** Parts of the screen that need to be redrawn. */
+    enum Dirty {
+        DIRTY_WINDOW = 1,
+        DIRTY_STATUSBAR = 2,
+        DIRTY_INPUT = 4,
+        DIRTY_ALL = DIRTY_WINDOW | DIRTY_STATUSBAR | DIRTY_INPUT
+    };
+
     Manager();
 
     Windows::iterator begin() { return m_windows->begin(); }
     Windows::iterator end() { return m_windows->end(); }
 
-    /** Redraw the screen. */
+    /** Mark parts of the screen to be drawn by the next redraw(). */
+    void set_dirty(int dirty) { m_dirty |= dirty; }
+
+    /** Redraw the parts of the screen that have changed. */
     void redraw();
 
     /** Handle key combos for changing window. */
@@ -103,6 +114,7 @@ private:
     display::StatusBar *m_statusbar; //!< The status bar
     display::InputWindow m_inputWindow; //!< The input window
     bool m_altPressed; //!< Used by key_pressed to check if alt was pressed
+    int m_dirty; //!< Parts of the screen to redraw, see Dirty
 };
 
 } // namespace display
@@ -31,6 +31,7 @@
 namespace display {
 
 ScrolledWindow::ScrolledWindow():
+    m_lines(200),
     m_scrollPosition(0),
     m_lastlogSize(200),
     m_timestamp("[%H:%M:%S] ")
@@ -39,7 +40,6 @@ ScrolledWindow::ScrolledWindow():
     m_bindings[KEY_NPAGE] = std::bind(&ScrolledWindow::scroll_window, this, 10);
 
     update_config();
-    m_lines.reserve(m_lastlogSize);
     m_state = STATE_NO_ACTIVITY;
 }
 
@@ -47,6 +47,12 @@ void ScrolledWindow::update_config()
 {
     m_lastlogSize = core::Settings::get()->find_int("lastlog_size", 200);
     m_timestamp = core::Settings::get()->find("timestamp_format", "[%H:%M:%S] ");
+
+    utils::Lock lock(m_lineLock);
+    bool bottom = m_scrollPosition == m_lines.size();
+    m_lines.set_capacity(m_lastlogSize);
+    if(bottom || m_scrollPosition > m_lines.size())
+        m_scrollPosition = m_lines.size();
 }
 
 void ScrolledWindow::handle(wint_t key)
@@ -56,12 +62,12 @@ void ScrolledWindow::handle(wint_t key)
     }
     else if(key >= 0x20 && key < 0xFF) {
         m_input.key_insert(key);
-        events::emit("window updated", dynamic_cast<display::Window*>(this));
+        events::emit(events::WINDOW_UPDATED, dynamic_cast<display::Window*>(this));
     }
     else {
         /* backspace, arrow keys.. */
         m_input.pressed(key);
-        events::emit("window updated", dynamic_cast<display::Window*>(this));
+        events::emit(events::WINDOW_UPDATED, dynamic_cast<display::Window*>(this));
     }
 }
 
@@ -69,21 +75,23 @@ void ScrolledWindow::add_line(const display::LineEntry &line_,
         bool redraw_screen /* = true */)
 {
     m_lineLock.lock();
-    if(m_lines.size() >= m_lastlogSize)
-        m_lines.erase(m_lines.begin());
+    bool bottom = m_scrollPosition == m_lines.size();
 
-    display::LineEntry line = koskenkorva_viina(line_);
+    /* the oldest line is dropped, keep showing the same lines */
+    if(m_lines.full() && !bottom && m_scrollPosition > 0)
+        m_scrollPosition--;
+
+    display::LineEntry &line = m_lines.push_back(line_);
+    koskenkorva_viina(line);
 
     /* scroll the window if we are at the bottom */
-    if(m_scrollPosition == m_lines.size()) {
-        m_scrollPosition++;
+    if(bottom) {
+        m_scrollPosition = m_lines.size();
     }
-
-    m_lines.push_back(line);
     m_lineLock.unlock();
 
     if(redraw_screen && m_state == STATE_IS_ACTIVE) {
-        events::emit("window updated", this);
+        events::emit(events::WINDOW_UPDATED, this);
     }
     else if(m_state != STATE_IS_ACTIVE) {
         if(line.m_type == LineEntry::HIGHLIGHT) {
@@ -97,13 +105,12 @@ void ScrolledWindow::add_line(const display::LineEntry &line_,
         {
             m_state = STATE_ACTIVITY;
         }
-        events::emit("window status updated", dynamic_cast<Window*>(this), m_state);
+        events::emit(events::WINDOW_STATUS_UPDATED, dynamic_cast<Window*>(this), m_state);
     }
 }
 
-LineEntry ScrolledWindow::koskenkorva_viina(const display::LineEntry &line_)
+void ScrolledWindow::koskenkorva_viina(display::LineEntry &line)
 {
-    display::LineEntry line = line_;
     std::string text;
  
     text = utils::time_to_string(m_timestamp, line.m_time);
@@ -112,8 +119,29 @@ LineEntry ScrolledWindow::koskenkorva_viina(const display::LineEntry &line_)
     if(line.m_type == LineEntry::ACTIVITY)
         text += "%21%01-%01!%01-%01%21 ";
 
-    line.m_text = text + line.str();
-    return line;
+    line.m_text.insert(0, text);
+}
+
+const LineEntry::Layout& ScrolledWindow::layout(display::LineEntry &line, unsigned int width)
+{
+    if(line.m_layoutWidth == width)
+        return line.m_layout;
+
+    const std::string &message = line.m_text;
+    unsigned int indent = width > line.m_indent + 4 ? line.m_indent : 0;
+
+    line.m_layout.clear();
+    std::string::size_type i = 0;
+    while(i < message.length()) {
+        std::string::size_type start = i;
+        i = Window::find_line_end(message, i, i == 0 ? width : width - indent);
+        line.m_layout.push_back(std::make_pair(start, i));
+
+        for(i++; i < message.length() && isspace(message[i]); i++);
+    }
+
+    line.m_layoutWidth = width;
+    return line.m_layout;
 }
 
 void ScrolledWindow::scroll_window(int lines)
@@ -126,7 +154,7 @@ void ScrolledWindow::scroll_window(int lines)
     if(m_scrollPosition > m_lines.size())
         m_scrollPosition = m_lines.size();
 
-    events::emit("window updated", this);
+    events::emit(events::WINDOW_UPDATED, this);
 }
 
 void ScrolledWindow::redraw()
@@ -135,51 +163,35 @@ void ScrolledWindow::redraw()
     unsigned int window_height = get_height();
     unsigned int window_width = get_width();
 
-    /* Find out the first message to print */
-    int first = m_scrollPosition;
-    int line = std::min<size_t>(get_height(), m_lines.size());
+    utils::Lock lock(m_lineLock);
+
+    /* Find out the first message to print, line is < 0 if
+     * the first message doesn't fit completely on the screen */
+    unsigned int first = m_scrollPosition;
+    int line = window_height;
 
     while(first > 0 && line > 0) {
-        LineEntry lineEntry;
-        try {
-            lineEntry = m_lines.at(first-1);
-        } catch(std::exception &e) {
-            set_title("bUG in ScrolledWindow::redraw" +
-                    std::string(e.what() + utils::to_string(first)));
-        }
-        line -= Window::calculate_height(lineEntry.str(), window_width,
-                    lineEntry.m_indent);
+        line -= layout(m_lines[first-1], window_width).size();
         first--;
     }
 
-    /* Iterator to the first message to print */
-    std::vector<LineEntry>::iterator it = m_lines.end() - (m_lines.size()-first);
-
     Window::erase();
 
-    for(size_t height=0; it != m_lines.end() && height < window_height; ++it) {
-        std::string message = it->str();
-
-        std::string::size_type i = 0;
-        while(i < message.length()) {
-            std::string indentation;
-            std::string::size_type tmp = i;
-            if(i == 0) {
-                i = Window::find_line_end(message, i, window_width);
-            }
-            else {
-                i = Window::find_line_end(message, i, window_width-it->m_indent);
-                indentation = std::string(it->m_indent, ' ');
-            }
-
-            /* line is < 0 if the first message doesn't
-             * fit completely on the screen */
-            if(++line > 0) {
-                print(indentation + message.substr(tmp, i-tmp+1), 0, height++);
-                i++;
-            }
-
-            for(; i < message.length() && isspace(message[i]); i++);
+    unsigned int height = 0;
+    for(unsigned int n = first; n < m_lines.size() && height < window_height; ++n) {
+        LineEntry &entry = m_lines[n];
+        const LineEntry::Layout &wrapped = layout(entry, window_width);
+        std::string indentation(window_width > entry.m_indent + 4 ? entry.m_indent : 0, ' ');
+
+        for(LineEntry::Layout::const_iterator i = wrapped.begin(); i != wrapped.end() && height < window_height; ++i) {
+            if(line++ < 0)
+                continue;
+
+            const std::string &message = entry.m_text;
+            if(i == wrapped.begin())
+                print(message.substr(i->first, i->second - i->first + 1), 0, height++);
+            else
+                print(indentation + message.substr(i->first, i->second - i->first + 1), 0, height++);
         }
 
         Window::clear_flags();
@@ -29,6 +29,7 @@
 #include <core/settings.h>
 #include <display/window.h>
 #include <utils/mutex.h>
+#include <utils/ring_buffer.h>
 
 namespace display {
 
@@ -44,20 +45,26 @@ public:
         m_text(text),
         m_indent(indent),
         m_time(time_),
-        m_type(type)
+        m_type(type),
+        m_layoutWidth(0)
     {
         if(m_time == -1)
             m_time = time(0);
     }
 
-    LineEntry() { }
+    LineEntry(): m_layoutWidth(0) { }
 
     std::string str() { return m_text; }
 private:
+    /** First and last byte of each screen line the text wraps to */
+    typedef std::vector<std::pair<std::string::size_type, std::string::size_type> > Layout;
+
     std::string m_text;
     unsigned int m_indent;
     time_t m_time;
     Type m_type;
+    Layout m_layout;
+    unsigned int m_layoutWidth; //!< Window width m_layout was made for, 0 if none
     friend class ScrolledWindow;
 };
 
@@ -80,11 +87,14 @@ public:
     void scroll_window(int lines);
 private:
     void set_activity(display::LineEntry::Type type);
-    display::LineEntry koskenkorva_viina(const display::LineEntry &line);
+    void koskenkorva_viina(display::LineEntry &line);
+
+    /** Get the wrapped lines of an entry, wrapping it if the width has changed. */
+    const display::LineEntry::Layout& layout(display::LineEntry &line, unsigned int width);
 
     utils::Mutex m_messageLock;
     utils::Mutex m_lineLock;
-    std::vector<display::LineEntry> m_lines;
+    utils::RingBuffer<display::LineEntry> m_lines;
     unsigned int m_scrollPosition; //!< Number of the first line to show on the screen
     unsigned int m_lastlogSize;
     std::string m_timestamp;
@@ -1,17 +1,21 @@
-
 #include "completion.h"
 #include <functional>
 #include <algorithm>
 
 namespace input {
 
-bool _default_comparator(std::string s1, std::string s2)
+std::string _default_normalizer(const std::string &str)
+{
+    return str;
+}
+
+bool Completion::cache_less(Items::const_iterator a, Items::const_iterator b)
 {
-    return s1.find(s2) == 0;
+    return *a < *b;
 }
 
 Completion::Completion():
-    m_comparator(_default_comparator),
+    m_normalizer(_default_normalizer),
     m_items(),
     m_cachedItems(),
     m_currentItem(-1),
@@ -22,43 +26,75 @@ Completion::Completion():
 
 Completion& Completion::add_item(const std::string &item, bool cache)
 {
-    m_items.push_back(item);
-    std::sort(m_cachedItems.begin(), m_cachedItems.end());
-    if(cache && m_comparator(item, m_prefix)) {
-        m_cachedItems.push_back(item);
-        std::sort(m_cachedItems.begin(), m_cachedItems.end());
+    std::pair<Items::iterator, bool> added =
+        m_items.insert(std::make_pair(m_normalizer(item), item));
+
+    if(added.second && cache && matches(added.first->first)) {
+        Cache::iterator it = std::lower_bound(m_cachedItems.begin(),
+            m_cachedItems.end(), added.first, cache_less);
+        if(it - m_cachedItems.begin() <= m_currentItem)
+            m_currentItem++;
+        m_cachedItems.insert(it, added.first);
     }
     return *this;
 }
 
 Completion& Completion::add_items(const std::vector<std::string> &items)
 {
-    std::copy(items.begin(), items.end(), std::back_inserter(m_items));
+    for(std::vector<std::string>::const_iterator it = items.begin(); it != items.end(); ++it)
+        add_item(*it, false);
+    return *this;
+}
+
+Completion& Completion::remove_item(const std::string &item)
+{
+    Items::iterator found = m_items.find(std::make_pair(m_normalizer(item), item));
+    if(found == m_items.end())
+        return *this;
+
+    Cache::iterator it = std::lower_bound(m_cachedItems.begin(),
+        m_cachedItems.end(), found, cache_less);
+    if(it != m_cachedItems.end() && *it == found) {
+        if(it - m_cachedItems.begin() <= m_currentItem)
+            m_currentItem--;
+        m_cachedItems.erase(it);
+    }
+
+    m_items.erase(found);
     return *this;
 }
 
 Completion& Completion::create_cache()
 {
     m_cachedItems.clear();
-    // since there is not std::copy_if
-    std::remove_copy_if(m_items.begin(), m_items.end(),
-            std::back_inserter(m_cachedItems),
-            std::not1(std::bind2nd(
-                    std::ptr_fun(m_comparator), m_prefix)));
-    std::sort(m_cachedItems.begin(), m_cachedItems.end());
+    m_currentItem = -1;
+
+    /* the matching items are next to each other, from the first
+     * item not less than the prefix on */
+    Items::const_iterator it = m_items.lower_bound(std::make_pair(m_prefix, std::string()));
+    for(; it != m_items.end() && matches(it->first); ++it)
+        m_cachedItems.push_back(it);
     return *this;
 }
 
+std::vector<std::string> Completion::get_matches()
+{
+    std::vector<std::string> matches;
+    for(Cache::const_iterator it = m_cachedItems.begin(); it != m_cachedItems.end(); ++it)
+        matches.push_back((*it)->second);
+    return matches;
+}
+
 std::string Completion::next()
     throw(std::out_of_range)
 {
     if(m_cachedItems.size() == 0)
         throw std::out_of_range("Completion::next()");
 
-    if(++m_currentItem > static_cast<int>(m_cachedItems.size()-1) || m_currentItem == -1)
+    if(++m_currentItem > static_cast<int>(m_cachedItems.size()-1) || m_currentItem < 0)
         m_currentItem = 0;
 
-    return m_cachedItems.at(m_currentItem);
+    return m_cachedItems.at(m_currentItem)->second;
 }
 
 } // namespace input
@@ -1,21 +1,23 @@
-
 #ifndef _COMPLETION_H_
 #define _COMPLETION_H_
 
 #include <vector>
+#include <set>
 #include <string>
 #include <stdexcept>
 
 namespace input {
 
-/** String completion class. */
+/** String completion class. Items are kept ordered by their
+ * normalized form, so the matches of a prefix are found by
+ * a lookup instead of comparing every item. */
 class Completion
 {
 public:
     /** Constructor. */
     Completion();
 
-    /** Add a item to complete.
+    /** Add a item to complete. Adding an item twice has no effect.
      * @param item item
      * @param cache If true, item is added to cached items if it matches the prefix without need to call get_matches(). */
     Completion& add_item(const std::string &item, bool cache=true);
@@ -23,14 +25,17 @@ public:
     /** Add items to complete. */
     Completion& add_items(const std::vector<std::string> &items);
 
+    /** Remove an item, also from the cached items. */
+    Completion& remove_item(const std::string &item);
+
     /** Remove all items and clear the cache. */
-    Completion& clear() { m_items.clear(); m_cachedItems.clear(); return *this; }
+    Completion& clear() { m_cachedItems.clear(); m_items.clear(); return *this; }
 
     /** Call before calling next() or get_matches() */
     Completion& create_cache();
 
     /** Returns all strings which matches the prefix. */
-    std::vector<std::string> get_matches() { return m_cachedItems; }
+    std::vector<std::string> get_matches();
 
     /** Returns the next string matching the prefix.
      * @throw std::out_of_range if any of the items doesn't match the prefix. */
@@ -38,18 +43,29 @@ public:
 
     bool has_next() const { return m_cachedItems.size() != 0; }
 
-    Completion& set_prefix(const std::string &prefix) { m_prefix = prefix; return *this; }
+    Completion& set_prefix(const std::string &prefix) { m_prefix = m_normalizer(prefix); return *this; }
 
-    typedef bool (*Comparator)(std::string, std::string);
+    typedef std::string (*Normalizer)(const std::string &);
 
-    /** Set comparator so that you can treat '[FIN]morning' as 'morning' */
-    void set_comparator(Comparator comparator) { m_comparator = comparator; }
+    /** Set normalizer so that you can treat '[FIN]morning' as 'morning'.
+     * Items match if their normalized form starts with the normalized
+     * prefix. Call before adding items. */
+    void set_normalizer(Normalizer normalizer) { m_normalizer = normalizer; }
 private:
-    Comparator m_comparator;
-    std::vector<std::string> m_items;
-    std::vector<std::string> m_cachedItems;
+    /** Normalized form and the item */
+    typedef std::set<std::pair<std::string, std::string> > Items;
+    typedef std::vector<Items::const_iterator> Cache;
+
+    static bool cache_less(Items::const_iterator a, Items::const_iterator b);
+
+    bool matches(const std::string &key) const
+        { return key.compare(0, m_prefix.length(), m_prefix) == 0; }
+
+    Normalizer m_normalizer;
+    Items m_items;
+    Cache m_cachedItems; //!< Items matching the prefix, in order
     int m_currentItem;
-    std::string m_prefix;
+    std::string m_prefix; //!< Normalized
 };
 
 } // namespace input
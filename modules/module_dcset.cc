@@ -73,6 +73,11 @@ static Table intSettings[] = {
     { "skip_zero_byte", SettingsManager::SKIP_ZERO_BYTE },
     { "auto_search_auto_match", SettingsManager::AUTO_SEARCH_AUTO_MATCH },
     { "max_hash_speed", SettingsManager::MAX_HASH_SPEED },
+    { "throttle_up", SettingsManager::THROTTLE_UPLOAD },
+    { "throttle_down", SettingsManager::THROTTLE_DOWNLOAD },
+    { "throttle_up_conn", SettingsManager::THROTTLE_UPLOAD_CONN },
+    { "throttle_down_conn", SettingsManager::THROTTLE_DOWNLOAD_CONN },
+    { "connect_attempts", SettingsManager::CONNECT_ATTEMPTS },
     { "add_finished", SettingsManager::ADD_FINISHED_INSTANTLY },
     { "dont_dl_shared", SettingsManager::DONT_DL_ALREADY_SHARED },
     { "udp_port", SettingsManager::UDP_PORT },
@@ -30,6 +30,7 @@
 #include <utils/utils.h>
 #include <core/log.h>
 #include <core/events.h>
+#include <core/settings.h>
 #include <display/screen.h>
 #include <ui/manager.h>
 #include <ui/window_hub.h>
@@ -48,8 +49,14 @@
 namespace ui {
 
 Manager::Manager():
-    m_lastDraw(utils::get_millisecs())
+    m_lastDraw(utils::get_millisecs()),
+    m_frameScheduled(false),
+    m_frameEvent(events::id("screen frame"))
 {
+    update_config();
+    core::Settings::get()->add_listener(
+        std::bind(&Manager::update_config, this));
+
     events::add_listener("client created",
             std::bind(&Manager::create_windows, this));
 
@@ -57,21 +64,74 @@ Manager::Manager():
             std::bind(&Manager::init_statusbar, this));
 
     events::add_listener_first("window updated",
-        std::bind(&Manager::redraw_screen, this));
+        std::bind(&Manager::window_updated, this));
 
     events::add_listener_first("statusbar updated",
-        std::bind(&Manager::redraw_screen, this));
+        std::bind(&Manager::statusbar_updated, this));
+
+    /* after the window has handled the key */
+    events::add_listener_last("key pressed",
+        std::bind(&Manager::key_pressed, this));
+
+    events::add_listener("screen frame",
+        std::bind(&Manager::frame, this));
 }
 
-void Manager::redraw_screen()
+void Manager::update_config()
 {
-    m_screenMutex.lock();
+    if(!core::Settings::get()->changed("frame_rate"))
+        return;
 
-    if(m_lastDraw+20 < utils::get_millisecs()) {
-        display::Manager::get()->redraw();
-        m_lastDraw = utils::get_millisecs();
+    int fps = core::Settings::get()->find_int("frame_rate", 30);
+    m_frameInterval = 1000 / (fps > 0 ? fps : 1);
+}
+
+void Manager::window_updated()
+{
+    display::Manager::get()->set_dirty(display::Manager::DIRTY_WINDOW);
+    schedule_redraw();
+}
+
+void Manager::statusbar_updated()
+{
+    display::Manager::get()->set_dirty(display::Manager::DIRTY_STATUSBAR);
+    schedule_redraw();
+}
+
+void Manager::key_pressed()
+{
+    /* the user is waiting to see what happened */
+    display::Manager::get()->set_dirty(
+        display::Manager::DIRTY_WINDOW | display::Manager::DIRTY_INPUT);
+    redraw_screen();
+}
+
+void Manager::schedule_redraw()
+{
+    if(m_frameScheduled)
+        return;
+
+    uint32_t elapsed = utils::get_millisecs() - m_lastDraw;
+    if(elapsed >= m_frameInterval) {
+        redraw_screen();
+    }
+    else {
+        m_frameScheduled = true;
+        events::Manager::get()->emit_later(m_frameEvent, m_frameInterval - elapsed);
     }
-    m_screenMutex.unlock();
+}
+
+void Manager::frame()
+{
+    m_frameScheduled = false;
+    redraw_screen();
+}
+
+void Manager::redraw_screen()
+{
+    utils::Lock l(m_screenMutex);
+    display::Manager::get()->redraw();
+    m_lastDraw = utils::get_millisecs();
 }
 
 void Manager::init()
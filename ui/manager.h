@@ -30,6 +30,7 @@
 #include <utils/instance.h>
 #include <utils/mutex.h>
 #include <utils/lock.h>
+#include <core/events.h>
 
 #include <client/stdinc.h>
 #include <client/DCPlusPlus.h>
@@ -59,14 +60,30 @@ public:
     /** Creates statusbar elements. */
     void init_statusbar();
 
-    /** Redraws the screen. */
+    /** Redraws the changed parts of the screen now. */
     void redraw_screen();
 
+    /** Called when the config file is changed. */
+    void update_config();
+
     /** Destructor. */
     ~Manager();
 private:
+    /** Event handlers marking parts of the screen dirty */
+    void window_updated();
+    void statusbar_updated();
+    void key_pressed();
+
+    /** Redraw now if a frame interval has passed since the last
+     * redraw, otherwise make sure a redraw happens when it has. */
+    void schedule_redraw();
+    void frame();
+
     utils::Mutex m_screenMutex;
     uint32_t m_lastDraw;
+    uint32_t m_frameInterval; //!< Milliseconds between redraws
+    bool m_frameScheduled;
+    events::EventId m_frameEvent;
 };
 
 } // namespace ui
@@ -58,6 +58,9 @@ void StatusClock::update()
 
 void StatusClock::update_config()
 {
+    if(!core::Settings::get()->changed("clock_format"))
+        return;
+
     utils::Lock l(m_mutex);
     m_timeformat = core::Settings::get()->find("clock_format", "%H:%M:%S");
 }
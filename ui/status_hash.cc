@@ -76,7 +76,7 @@ void StatusHash::on(Second, u_int32_t)
 
 StatusHash::~StatusHash()
 {
-    TimerManager::getInstance()->removeListener(this);
+    TimerManager::getInstance()->removeListenerAndWait(this);
 }
 
 } // namespace ui
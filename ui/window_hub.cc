@@ -34,6 +34,21 @@
 
 namespace ui {
 
+namespace {
+
+/** Nicks are completed ignoring case and a leading [TAG] */
+std::string normalize_nick(const std::string &nick)
+{
+    std::string::size_type start = 0;
+    if(!nick.empty() && nick[0] == '[') {
+        std::string::size_type end = nick.find(']');
+        if(end != std::string::npos && end+1 < nick.length())
+            start = end+1;
+    }
+    return utils::tolower(nick.substr(start));
+}
+
+} // namespace
 
 WindowHub::WindowHub(const std::string &address):
     m_client(0),
@@ -45,7 +60,32 @@ WindowHub::WindowHub(const std::string &address):
     set_title(address);
     set_name(address);
     m_type = display::TYPE_HUBWINDOW;
+    m_nicks.set_normalizer(normalize_nick);
+    m_bindings['\t'] = std::bind(&WindowHub::complete_nick, this);
     update_config();
+    m_settingsConnection = core::Settings::get()->add_listener(
+        std::bind(&WindowHub::update_config, this));
+}
+
+void WindowHub::complete_nick()
+{
+    std::string line = m_input.str();
+    std::string::size_type start = line.rfind(' ');
+    start = start == std::string::npos ? 0 : start+1;
+    std::string word = line.substr(start);
+
+    utils::Lock l(m_mutex);
+
+    /* a new word to complete, not the one we put there */
+    if(word != m_lastCompletion)
+        m_nicks.set_prefix(word).create_cache();
+
+    if(!m_nicks.has_next())
+        return;
+
+    m_lastCompletion = m_nicks.next();
+    m_input.assign(line.substr(0, start) + m_lastCompletion);
+    m_input.set_pos(m_input.size());
 }
 
 void WindowHub::update_config()
@@ -57,6 +97,7 @@ void WindowHub::update_config()
     core::Settings *settings = core::Settings::get();
     m_showNicks = settings->find_vector("show_joins_nicks");
     m_ignoreNicks = settings->find_vector("ignore_nicks");
+    m_blockMessages = settings->find_vector("block_messages");
     m_highlights = settings->find_vector("hilight_words");
 
     if(m_client) {
@@ -94,19 +135,26 @@ void WindowHub::handle_line(const std::string &line)
 void WindowHub::on(TimerManagerListener::Second, u_int32_t)
     throw()
 {
-    utils::Lock l(m_mutex);
+    // Removed outside m_mutex, like in the other handlers
+    bool stopTimer = false;
+    {
+        utils::Lock l(m_mutex);
 
-    // group users in 2 seconds
-    if(m_lastJoin && !m_joined && m_lastJoin+2000 < TimerManager::getInstance()->getTick()) {
-        m_joined = true;
-        TimerManager::getInstance()->removeListener(this);
-        m_timer = false;
-        if(m_client->isConnected()) {
-            add_line(display::LineEntry("Joined to the hub"));
-            if(m_showNickList)
-                print_names();
+        // group users in 2 seconds
+        if(m_lastJoin && !m_joined && m_lastJoin+2000 < TimerManager::getInstance()->getTick()) {
+            m_joined = true;
+            stopTimer = true;
+            m_timer = false;
+            if(m_client->isConnected()) {
+                add_line(display::LineEntry("Joined to the hub"));
+                if(m_showNickList)
+                    print_names();
+            }
         }
     }
+
+    if(stopTimer)
+        TimerManager::getInstance()->removeListener(this);
 }
 
 void WindowHub::on(Message, Client *, const OnlineUser& user, const std::string& msg)
@@ -224,7 +272,11 @@ void WindowHub::on(UserUpdated, Client*, const OnlineUser &user)
     throw()
 {
     utils::Lock l(m_mutex);
+    user_updated(user, TimerManager::getInstance()->getTick());
+}
 
+void WindowHub::user_updated(const OnlineUser &user, int64_t tick)
+{
     std::string nick = user.getUser()->getFirstNick();
     if( m_joined
         && m_users.find(nick) == m_users.end()
@@ -253,69 +305,80 @@ void WindowHub::on(UserUpdated, Client*, const OnlineUser &user)
         add_line(display::LineEntry(oss.str()));
     }
 
-    m_lastJoin = TimerManager::getInstance()->getTick();
+    m_lastJoin = tick;
+    if(m_users.find(nick) == m_users.end())
+        m_nicks.add_item(nick);
     m_users[nick] = &user;
 }
 
 void WindowHub::on(UserRemoved, Client*, const OnlineUser &user)
     throw()
 {
-    utils::Lock l(m_mutex);
-
-    std::string nick = user.getUser()->getFirstNick();
-    m_users.erase(m_users.find(nick));
-
-    bool showJoin = m_showJoins || m_showJoinsOnThisHub ||
-                    utils::find_in_string(nick, m_showNicks.begin(),
-                            m_showNicks.end());
-
-    if(m_users.find(nick) == m_users.end() && m_joined && showJoin)
+    // Not under m_mutex, on(Second) takes it too
+    bool stopTimer = false;
     {
-        // Lehmis [127.0.0.1] has left the hub
-        std::ostringstream oss;
-        std::string ip = user.getIdentity().getIp();
-        oss << "%03" << nick << "%03 ";
-        if(!ip.empty()) {
-            if(m_resolveIps) {
-                try {
-                    ip = utils::ip_to_host(ip);
-                } catch(std::exception &e) {
-                    //core::Log::get()->log("utils::ip_to_host(" + ip + "): " + std::string(e.what()));
+        utils::Lock l(m_mutex);
+
+        std::string nick = user.getUser()->getFirstNick();
+        m_users.erase(m_users.find(nick));
+        m_nicks.remove_item(nick);
+
+        bool showJoin = m_showJoins || m_showJoinsOnThisHub ||
+                        utils::find_in_string(nick, m_showNicks.begin(),
+                                m_showNicks.end());
+
+        if(m_users.find(nick) == m_users.end() && m_joined && showJoin)
+        {
+            // Lehmis [127.0.0.1] has left the hub
+            std::ostringstream oss;
+            std::string ip = user.getIdentity().getIp();
+            oss << "%03" << nick << "%03 ";
+            if(!ip.empty()) {
+                if(m_resolveIps) {
+                    try {
+                        ip = utils::ip_to_host(ip);
+                    } catch(std::exception &e) {
+                        //core::Log::get()->log("utils::ip_to_host(" + ip + "): " + std::string(e.what()));
+                    }
                 }
+                oss << "%21%08[%21%08" << ip 
+                    << "%21%08]%21%08 ";
             }
-            oss << "%21%08[%21%08" << ip 
-                << "%21%08]%21%08 ";
-        }
 
-        oss << "has left the hub";
-        add_line(display::LineEntry(oss.str()));
-    }
-
-    if(!m_joined) {
-        m_joined = true;
-        if(m_timer) {
-            TimerManager::getInstance()->removeListener(this);
-            m_timer = false;
+            oss << "has left the hub";
+            add_line(display::LineEntry(oss.str()));
         }
-        if(m_client->isConnected()) {
-            add_line(display::LineEntry("Joined to the hub"));
-            if(m_showNickList)
-                print_names();
-        }
-        else {
-            core::Log::get()->log(m_client->getAddress() + " is not connected");
+
+        if(!m_joined) {
+            m_joined = true;
+            if(m_timer) {
+                stopTimer = true;
+                m_timer = false;
+            }
+            if(m_client->isConnected()) {
+                add_line(display::LineEntry("Joined to the hub"));
+                if(m_showNickList)
+                    print_names();
+            }
+            else {
+                core::Log::get()->log(m_client->getAddress() + " is not connected");
+            }
         }
     }
+
+    if(stopTimer)
+        TimerManager::getInstance()->removeListener(this);
 }
 
 void WindowHub::on(UsersUpdated, Client*, const OnlineUser::List &users)
     throw()
 {
     utils::Lock l(m_mutex);
-    
+
+    int64_t tick = TimerManager::getInstance()->getTick();
     OnlineUser::List::const_iterator it;
     for(it = users.begin(); it != users.end(); ++it) {
-        m_users[(*it)->getUser()->getFirstNick()] = *it;
+        user_updated(**it, tick);
     }
 }
 
@@ -341,17 +404,25 @@ void WindowHub::on(HubUpdated, Client *client)
 void WindowHub::on(Failed, Client*, const string& msg)
     throw()
 {
-    utils::Lock l(m_mutex);
+    // Not under m_mutex, on(Second) takes it too
+    bool stopTimer = false;
+    {
+        utils::Lock l(m_mutex);
 
-    set_title(m_client->getAddress() + " (offline)");
-    add_line(display::LineEntry(msg));
-    m_joined = false;
-    if(m_timer) {
-        TimerManager::getInstance()->removeListener(this);
-        m_timer = false;
+        set_title(m_client->getAddress() + " (offline)");
+        add_line(display::LineEntry(msg));
+        m_joined = false;
+        if(m_timer) {
+            stopTimer = true;
+            m_timer = false;
+        }
+        m_lastJoin = 0;
+        m_users.clear();
+        m_nicks.clear();
     }
-    m_lastJoin = 0;
-    m_users.clear();
+
+    if(stopTimer)
+        TimerManager::getInstance()->removeListener(this);
 }
 
 void WindowHub::connect(std::string address, std::string nick, std::string password, std::string desc)
@@ -435,16 +506,7 @@ bool WindowHub::filter_messages(const std::string &nick, const std::string &msg)
 {
     utils::Lock l(m_mutex);
 
-    core::Settings *settings = core::Settings::get();
-    core::StringVector blocked;
-
-    if(!settings->exists("block_messages")) {
-        // block urls by default
-        core::Settings::get()->set("block_messages", "http://;www.");
-    }
-    blocked = core::Settings::get()->find_vector("block_messages");
-
-    if (utils::find_in_string(msg, blocked.begin(), blocked.end()) ||
+    if (utils::find_in_string(msg, m_blockMessages.begin(), m_blockMessages.end()) ||
         utils::find_in_string(nick, m_ignoreNicks.begin(), m_ignoreNicks.end()))
     {
         core::Log::get()->log("%21Ignore:%21 from: " + nick + ", msg: " + msg, core::MT_DEBUG);
@@ -480,14 +542,18 @@ const OnlineUser *WindowHub::get_user(const std::string &nick)
 
 WindowHub::~WindowHub()
 {
-    if(m_timer)
-        TimerManager::getInstance()->removeListener(this);
+    m_settingsConnection.disconnect();
+
+    /* m_timer is only read under m_mutex; removing a listener
+     * that isn't registered does nothing */
+    TimerManager::getInstance()->removeListenerAndWait(this);
 
     if(m_client) {
         m_client->removeListener(this);
         ClientManager::getInstance()->putClient(m_client);
     }
     m_users.clear();
+    m_nicks.clear();
 }
 
 } // namespace ui
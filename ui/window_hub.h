@@ -30,6 +30,7 @@
 #include <client/ClientManager.h>
 #include <client/TimerManager.h>
 #include <display/scrolled_window.h>
+#include <input/completion.h>
 #include <utils/mutex.h>
 #include <map>
 #include <string>
@@ -52,6 +53,10 @@ public:
     Client* get_client() const { return m_client; }
     void print_names();
 
+    /** Complete the nick at the end of the input line. Pressing
+     * again replaces it with the next match. */
+    void complete_nick();
+
     /** @todo regular expressions in filters */
     bool filter_messages(const std::string &nick, const std::string &msg);
     std::string get_nick() const;
@@ -78,6 +83,9 @@ public:
     virtual void on(NickTaken, Client*) throw() { add_line(display::LineEntry("Nick taken")); }
     virtual void on(SearchFlood, Client*, const string &msg) throw() { add_line(display::LineEntry(msg)); }
 private:
+    /** Records user in the nick list, m_mutex must be held */
+    void user_updated(const OnlineUser &user, int64_t tick);
+
     Client *m_client;
     int64_t m_lastJoin;
     bool m_joined;
@@ -86,8 +94,11 @@ private:
     typedef Users::const_iterator UserIter;
     Users m_users;
     UserIter m_currentUser;
+    input::Completion m_nicks; //!< Guarded by m_mutex like m_users
+    std::string m_lastCompletion;
     core::StringVector m_showNicks;
     core::StringVector m_ignoreNicks;
+    core::StringVector m_blockMessages;
     core::StringVector m_highlights;
     bool m_showJoins;
     bool m_showJoinsOnThisHub;
@@ -97,6 +108,7 @@ private:
     std::string m_nmdcCharset;
 
     mutable utils::Mutex m_mutex;
+    boost::signals::connection m_settingsConnection;
 };
 
 } // namespace ui
@@ -26,6 +26,7 @@
 #include <iomanip>
 #include <functional>
 #include <ui/window_search.h>
+#include <core/events.h>
 #include <utils/utils.h>
 #include <utils/strings.h>
 
@@ -36,6 +37,7 @@ WindowSearch::WindowSearch(const std::string &str):
     m_property(PROP_NONE),
     m_lastSearch(0),
     m_search(str),
+    m_sortColumn(SORT_NONE),
     m_minSize(0),
     m_maxSize(0),
     m_freeSlots(false)
@@ -45,8 +47,6 @@ WindowSearch::WindowSearch(const std::string &str):
 
     set_title("Search");
 
-    // hidden column for identifying the rows
-    insert_column(new display::Column("User-TTH"));
     insert_column(new display::Column("Slots", 6, 7, 8));
     insert_column(new display::Column("Size", 10, 10, 10));
     insert_column(new display::Column("File name", 50, 200, 200));
@@ -68,15 +68,14 @@ WindowSearch::WindowSearch(const std::string &str):
     m_bindings['S'] = std::bind(&WindowSearch::set_property, this, PROP_DIRECTORYTARGET);
 
     // browse
-    m_bindings['b'] = std::bind(&QueueManager::addList, QueueManager::getInstance(),
-                         std::bind(&WindowSearch::get_user, this), QueueItem::FLAG_CLIENT_VIEW);
+    m_bindings['b'] = std::bind(&WindowSearch::add_list, this, QueueItem::FLAG_CLIENT_VIEW);
     // match queue
-    m_bindings['M'] = std::bind(&QueueManager::addList, QueueManager::getInstance(),
-                         std::bind(&WindowSearch::get_user, this), QueueItem::FLAG_MATCH_QUEUE);
+    m_bindings['M'] = std::bind(&WindowSearch::add_list, this, QueueItem::FLAG_MATCH_QUEUE);
     // search
     m_bindings['r'] = std::bind(&WindowSearch::search, this, std::string());
 
     m_bindings['l'] = std::bind(&WindowSearch::toggle_slots, this);
+    m_bindings['o'] = std::bind(&WindowSearch::toggle_sort, this);
     m_bindings['n'] = std::bind(&WindowSearch::set_property, this, PROP_MINSIZE);
     m_bindings['m'] = std::bind(&WindowSearch::set_property, this, PROP_MAXSIZE);
     m_bindings['e'] = std::bind(&WindowSearch::set_property, this, PROP_EXTENSION);
@@ -87,21 +86,30 @@ WindowSearch::WindowSearch(const std::string &str):
 
 SearchResult *WindowSearch::get_result()
 {
-    SearchResult* result;
-    std::string cid = get_text(0, get_selected_row());
-    std::string::size_type n = cid.find('-');
-    std::string tth = cid.substr(n+1);
-    cid = cid.substr(0, n);
-
-    for(unsigned int i=0; i<m_results.size(); ++i) {
-        result = m_results[i];
-        if(cid == result->getUser()->getCID().toBase32() &&
-           tth == result->getTTH().toBase32())
-        {
-            return result;
-        }
+    int row = get_selected_row();
+    if(row < 0 || row >= static_cast<int>(m_shown.size()))
+        return 0;
+    return m_shown[row]->result;
+}
+
+User::Ptr WindowSearch::get_user()
+{
+    SearchResult *result = get_result();
+    return result ? result->getUser() : User::Ptr();
+}
+
+void WindowSearch::add_list(int flags)
+{
+    User::Ptr user = get_user();
+    if(!user)
+        return;
+
+    try {
+        QueueManager::getInstance()->addList(user, flags);
+    }
+    catch(const Exception &e) {
+        core::Log::get()->log("Error getting the file list: " + e.getError());
     }
-    return 0;
 }
 
 void WindowSearch::set_property(Property property)
@@ -140,9 +148,7 @@ void WindowSearch::search(const std::string &str)
         m_search = utils::tolower(str);
         strings::split(m_search, " ", std::back_inserter(m_searchWords));
 
-        utils::Lock lock(m_resultLock);
-        std::for_each(m_results.begin(), m_results.end(), std::mem_fun(&SearchResult::decRef));
-        m_results.clear();
+        clear_results();
     }
 
     set_title("Search window: " + m_search);
@@ -154,6 +160,9 @@ void WindowSearch::search(const std::string &str)
 
 void WindowSearch::handle_line(const std::string &line)
 {
+    /* a stricter filter only needs to look at the shown results */
+    bool stricter = false;
+
     if(!line.empty()) {
         if(m_property == PROP_FILETARGET) {
             download(line);
@@ -190,10 +199,14 @@ void WindowSearch::handle_line(const std::string &line)
                     size *= 1024*1024;
                     break;
             }
-            if(m_property == PROP_MINSIZE)
+            if(m_property == PROP_MINSIZE) {
+                stricter = size >= m_minSize;
                 m_minSize = size;
-            else
+            }
+            else {
+                stricter = size && (!m_maxSize || size <= m_maxSize);
                 m_maxSize = size;
+            }
         }
         else if(m_property == PROP_EXTENSION) {
             m_extensions.clear();
@@ -207,45 +220,155 @@ void WindowSearch::handle_line(const std::string &line)
     if(!line.empty() && m_property != PROP_FILETARGET &&
         m_property != PROP_DIRECTORYTARGET)
     {
-        create_list();
+        if(stricter)
+            filter_list();
+        else
+            create_list();
     }
     m_property = PROP_NONE;
 }
 
 void WindowSearch::create_list()
 {
+    flush_results();
+
+    Entries entries;
+    if(m_maxSize && m_maxSize < m_minSize) {
+        /* nothing fits */
+    }
+    else if(m_minSize || m_maxSize) {
+        /* only the results in the size range need to be looked at */
+        SizeMap::iterator it = m_bySize.lower_bound(m_minSize);
+        SizeMap::iterator end = m_maxSize ? m_bySize.upper_bound(m_maxSize) : m_bySize.end();
+        for(; it != end; ++it) {
+            if(matches(it->second))
+                entries.push_back(it->second);
+        }
+    }
+    else {
+        for(Entries::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if(matches(*it))
+                entries.push_back(*it);
+        }
+    }
+
+    fill_list(entries);
+}
+
+void WindowSearch::filter_list()
+{
+    flush_results();
+
+    Entries entries;
+    for(Entries::iterator it = m_shown.begin(); it != m_shown.end(); ++it) {
+        if(matches(*it))
+            entries.push_back(*it);
+    }
+
+    fill_list(entries);
+}
+
+void WindowSearch::fill_list(Entries &entries)
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    std::sort(entries.begin(), entries.end(),
+        std::bind(&WindowSearch::sorted_before, this, _1, _2));
+
+    /* delete_all() asks for the one redraw the whole list needs */
     delete_all();
+    m_shown.swap(entries);
+    for(Entries::iterator it = m_shown.begin(); it != m_shown.end(); ++it) {
+        int row = insert_row();
+        set_cell(0, row, (*it)->slots);
+        set_cell(1, row, (*it)->size);
+        set_cell(2, row, (*it)->file);
+    }
 
-    m_resultLock.lock();
-    std::for_each(m_results.begin(), m_results.end(),
-        std::bind(&WindowSearch::add_result, this,
-            std::placeholders::_1));
-    m_resultLock.unlock();
+    update_title();
+}
 
+void WindowSearch::update_title()
+{
     std::ostringstream oss;
     oss << "Search: " << m_search << " with " << get_size()
-        << "/" << m_results.size() << " results";
+        << "/" << m_entries.size() << " results";
     set_title(oss.str());
 
     set_name("Search:" + m_search);
 }
 
+void WindowSearch::toggle_slots()
+{
+    m_freeSlots = !m_freeSlots;
+    if(m_freeSlots)
+        filter_list();
+    else
+        create_list();
+}
+
+void WindowSearch::toggle_sort()
+{
+    m_sortColumn = static_cast<SortColumn>((m_sortColumn+1) % SORT_LAST);
+
+    Entries entries(m_shown);
+    fill_list(entries);
+}
+
+bool WindowSearch::sorted_before(const Entry *a, const Entry *b) const
+{
+    SearchResult *x = a->result;
+    SearchResult *y = b->result;
+
+    switch(m_sortColumn) {
+        case SORT_SLOTS:
+            if(x->getFreeSlots() != y->getFreeSlots())
+                return x->getFreeSlots() > y->getFreeSlots();
+            break;
+        case SORT_SIZE:
+            if(x->getSize() != y->getSize())
+                return x->getSize() > y->getSize();
+            break;
+        case SORT_NAME:
+        {
+            int cmp = a->name.compare(b->name);
+            if(cmp)
+                return cmp < 0;
+            break;
+        }
+        default:
+            break;
+    }
+    return a->order < b->order;
+}
+
 void WindowSearch::on(SearchManagerListener::SR, SearchResult* result)
     throw()
 {
     try {
-        result->incRef();
+        /* one result per user and file, even if it comes from several hubs */
+        std::string key(reinterpret_cast<const char*>(result->getUser()->getCID().data()), CID::SIZE);
+        if(result->getType() == SearchResult::TYPE_FILE)
+            key.append(reinterpret_cast<const char*>(result->getTTH().data), TTHValue::SIZE);
+        else
+            key.append(result->getFile());
 
-        m_resultLock.lock();
-        m_results.push_back(result);
-        m_resultLock.unlock();
+        /* the results are added to the list when the window is
+         * redrawn, so a burst of them costs one redraw per frame */
+        bool first;
+        {
+            utils::Lock lock(m_resultLock);
+            if(!m_seen.insert(key).second)
+                return;
 
-        add_result(result);
+            result->incRef();
+            first = m_pending.empty();
+            m_pending.push_back(result);
+        }
 
-        std::ostringstream oss;
-        oss << "Search: " << m_search << " with " << get_size()
-            << "/" << m_results.size() << " results";
-        set_title(oss.str());
+        if(first)
+            events::emit("window updated", dynamic_cast<display::Window*>(this));
     } catch(const Exception &e) {
         core::Log::get()->log("WindowSearch::on(): Exception " + e.getError());
     }
@@ -265,21 +388,66 @@ std::string escape_and_get_filename(const std::string &str)
     return (i != std::string::npos) ? temp.substr(i + 1) : temp;
 }
 
-void WindowSearch::add_result(SearchResult *result)
+void WindowSearch::flush_results()
 {
-    if(matches(result)) {
-        int row = insert_row();
-        set_text(0, row, result->getUser()->getCID().toBase32() + "-" + result->getTTH().toBase32());
-        set_text(1, row, utils::to_string(result->getFreeSlots())
-            + "/" + utils::to_string(result->getSlots()));
-        set_text(2, row, Util::formatBytes(result->getSize()));
-        set_text(3, row, escape_and_get_filename(result->getFileName()));
+    std::vector<SearchResult*> results;
+    {
+        utils::Lock lock(m_resultLock);
+        results.swap(m_pending);
     }
+
+    if(results.empty())
+        return;
+
+    for(std::vector<SearchResult*>::iterator it = results.begin(); it != results.end(); ++it) {
+        SearchResult *result = *it;
+
+        Entry *entry = new Entry();
+        entry->result = result;
+        entry->order = m_entries.size();
+        entry->name = utils::tolower(result->getFileName());
+        entry->slots = utils::to_string(result->getFreeSlots())
+            + "/" + utils::to_string(result->getSlots());
+        entry->size = Util::formatBytes(result->getSize());
+        entry->file = escape_and_get_filename(result->getFileName());
+
+        m_entries.push_back(entry);
+        m_bySize.insert(std::make_pair(result->getSize(), entry));
+
+        if(matches(entry))
+            show(entry);
+    }
+
+    update_title();
+}
+
+/** Called while flushing results, which happens before a redraw
+ * or before fill_list(), so the cells are set without updates. */
+void WindowSearch::show(Entry *entry)
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    Entries::iterator it = std::upper_bound(m_shown.begin(), m_shown.end(), entry,
+        std::bind(&WindowSearch::sorted_before, this, _1, _2));
+
+    int row = insert_row(it - m_shown.begin());
+    m_shown.insert(it, entry);
+    set_cell(0, row, entry->slots);
+    set_cell(1, row, entry->size);
+    set_cell(2, row, entry->file);
 }
 
-bool WindowSearch::matches(SearchResult *result)
+void WindowSearch::redraw()
 {
-    std::string filename = utils::tolower(result->getFileName());
+    flush_results();
+    display::ListView::redraw();
+}
+
+bool WindowSearch::matches(const Entry *entry)
+{
+    SearchResult *result = entry->result;
+    const std::string &filename = entry->name;
 
     if(!utils::find_in_string(filename, m_searchWords.begin(), m_searchWords.end())) {
         return false;
@@ -310,16 +478,34 @@ bool WindowSearch::matches(SearchResult *result)
 }
 
 void WindowSearch::free_results()
+{
+    clear_results();
+    update_title();
+}
+
+void WindowSearch::clear_results()
 {
     delete_all();
+    m_shown.clear();
+    m_bySize.clear();
+    for(Entries::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        (*it)->result->decRef();
+        delete *it;
+    }
+    m_entries.clear();
+
     utils::Lock lock(m_resultLock);
-    std::for_each(m_results.begin(), m_results.end(), std::mem_fun(&SearchResult::decRef));
-    m_results.clear();
+    std::for_each(m_pending.begin(), m_pending.end(), std::mem_fun(&SearchResult::decRef));
+    m_pending.clear();
+    m_seen.clear();
 }
 
 void WindowSearch::download(const std::string &path)
 {
     SearchResult *result = get_result();
+    if(!result)
+        return;
+
     std::string target = path.empty() ? SETTING(DOWNLOAD_DIRECTORY) : path;
     target = Text::utf8ToAcp(target);
     if(!target.empty() && target[target.length()-1] != '/')
@@ -354,6 +540,9 @@ void WindowSearch::download(const std::string &path)
 void WindowSearch::download_directory(const std::string &path)
 {
     SearchResult *result = get_result();
+    if(!result)
+        return;
+
     std::string target = target.empty() ? SETTING (DOWNLOAD_DIRECTORY) : target + "/";
     try {
         if(result->getType() == SearchResult::TYPE_FILE)
@@ -378,6 +567,8 @@ void WindowSearch::download_directory(const std::string &path)
 std::string WindowSearch::get_infobox_line(unsigned int n)
 {
     SearchResult *result = get_result();
+    if(!result)
+        return std::string();
 
     std::stringstream ss;
     switch(n) {
@@ -408,8 +599,7 @@ std::string WindowSearch::get_infobox_line(unsigned int n)
 WindowSearch::~WindowSearch()
 {
     SearchManager::getInstance()->removeListener(this);
-    utils::Lock lock(m_resultLock);
-    std::for_each(m_results.begin(), m_results.end(), std::mem_fun(&SearchResult::decRef));
+    clear_results();
 }
 
 } // namespace ui
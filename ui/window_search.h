@@ -25,6 +25,8 @@
 #define _WINDOWSEARCH_H_
 
 #include <vector>
+#include <map>
+#include <unordered_set>
 #include <client/stdinc.h>
 #include <client/DCPlusPlus.h>
 #include <client/SearchManager.h>
@@ -57,20 +59,29 @@ public:
     /** Handle user input. */
     void handle_line(const std::string &line);
 
-    /** Displays search result on the screen if it matches the filters */
-    void add_result(SearchResult *result);
-
     /** Decreases reference count of all added search results. */
     void free_results();
 
+    /** Fill the list with the results matching the filters. */
     void create_list();
 
     std::string get_infobox_line(unsigned int);
 
+    /** Get the selected result, or NULL if the list is empty. */
     SearchResult* get_result();
-    User::Ptr get_user() { return get_result()->getUser(); }
+    /** Get the user of the selected result, or NULL if there's none. */
+    User::Ptr get_user();
+
+    /** Queue the file list of the selected result's user. */
+    void add_list(int flags);
+
+    void toggle_slots();
+
+    /** Sort by the next column. */
+    void toggle_sort();
 
-    void toggle_slots() { m_freeSlots = !m_freeSlots; create_list(); }
+    /** Add the received results and redraw. */
+    virtual void redraw();
 
     enum Property {
         PROP_NONE,
@@ -89,13 +100,61 @@ public:
     /** Called when a search result is received. */
     virtual void on(SearchManagerListener::SR, SearchResult* result) throw();
 private:
+    /** A received result with its list columns formatted. */
+    struct Entry {
+        SearchResult *result;
+        unsigned int order; //!< Position in the order of arrival
+        std::string name; //!< Lower case file name for the filters
+        std::string slots;
+        std::string size;
+        std::string file;
+    };
+    typedef std::vector<Entry*> Entries;
+    typedef std::multimap<int64_t, Entry*> SizeMap;
+
+    enum SortColumn {
+        SORT_NONE,
+        SORT_SLOTS,
+        SORT_SIZE,
+        SORT_NAME,
+        SORT_LAST
+    };
+
+    /** Add the results received since the last call to the list. */
+    void flush_results();
+
+    /** Insert a row for the entry at its sorted position. */
+    void show(Entry *entry);
+
+    /** Replace the rows with \c entries. */
+    void fill_list(Entries &entries);
+
+    /** Refilter the shown results only, when the filters got stricter. */
+    void filter_list();
+
+    void clear_results();
+    void update_title();
+
+    /** Sort order of the list. Ties are in the order of arrival. */
+    bool sorted_before(const Entry *a, const Entry *b) const;
+
     bool m_shutdown;
     Property m_property;
     int64_t m_lastSearch;
     std::string m_search;
-    std::vector<SearchResult*> m_results;
+    SortColumn m_sortColumn;
+
+    /** Received from the search thread, not yet in the list.
+     * Guarded by m_resultLock, like m_seen. */
+    std::vector<SearchResult*> m_pending;
+    /** CID and TTH (or path for directories) of the received results */
+    std::unordered_set<std::string> m_seen;
     utils::Mutex m_resultLock;
 
+    Entries m_entries; //!< All results in the order of arrival
+    SizeMap m_bySize;
+    Entries m_shown; //!< The entry of each row, in the same order
+
     // search result filters
     std::vector<std::string> m_searchWords;
     int64_t m_minSize;
@@ -104,7 +163,7 @@ private:
     bool m_freeSlots;
 
     /** Returns true if search result matches current filters. */
-    bool matches(SearchResult *result);
+    bool matches(const Entry *entry);
 };
 
 } // namespace ui
@@ -21,107 +21,320 @@
  *  
  */
 
+#include <algorithm>
 #include <functional>
+#include <cctype>
 #include <core/log.h>
+#include <core/events.h>
 #include <utils/utils.h>
+#include <utils/lock.h>
 #include <ui/window_sharebrowser.h>
 
 namespace ui {
 
+namespace {
+
+/* Bytes of multibyte characters count as letters,
+ * only ASCII is case folded. */
+inline bool is_word_char(unsigned char c)
+{
+    return c >= 0x80 || std::isalnum(c);
+}
+
+inline char fold(unsigned char c)
+{
+    return c < 0x80 ? std::tolower(c) : c;
+}
+
+std::string fold(const std::string &str)
+{
+    std::string folded(str);
+    std::transform(folded.begin(), folded.end(), folded.begin(),
+        static_cast<char (*)(unsigned char)>(fold));
+    return folded;
+}
+
+/** Compare the word at \c offset of \c name to \c str. If \c prefix
+ * is true, only the first str.length() characters of the word count. */
+int compare_word(const std::string &name, uint32_t offset,
+        const std::string &str, bool prefix)
+{
+    std::string::size_type i = 0;
+    for(; offset+i < name.length() && is_word_char(name[offset+i]); ++i) {
+        if(i == str.length())
+            return prefix ? 0 : 1;
+        char c = fold(name[offset+i]);
+        if(c != str[i])
+            return c < str[i] ? -1 : 1;
+    }
+    return i == str.length() ? 0 : -1;
+}
+
+struct WordLess {
+    typedef WindowShareBrowser::Word Word;
+
+    bool operator()(const Word &a, const Word &b) const {
+        const std::string &x = a.file->getName();
+        const std::string &y = b.file->getName();
+        std::string::size_type i = a.offset, j = b.offset;
+        for(;; ++i, ++j) {
+            bool xend = i == x.length() || !is_word_char(x[i]);
+            bool yend = j == y.length() || !is_word_char(y[j]);
+            if(xend || yend)
+                return xend && !yend;
+            char c = fold(x[i]), d = fold(y[j]);
+            if(c != d)
+                return c < d;
+        }
+    }
+    bool operator()(const Word &a, const std::string &prefix) const {
+        return compare_word(a.file->getName(), a.offset, prefix, true) < 0;
+    }
+    bool operator()(const std::string &prefix, const Word &a) const {
+        return compare_word(a.file->getName(), a.offset, prefix, true) > 0;
+    }
+};
+
+/** Returns true if a word of \c name starts with \c word. */
+bool has_word(const std::string &name, const std::string &word)
+{
+    std::string::size_type i = name.find(word);
+    while(i != std::string::npos) {
+        if(i == 0 || !is_word_char(name[i-1]))
+            return true;
+        i = name.find(word, i+1);
+    }
+    return false;
+}
+
+/** Splits \c str into words the same way the names are indexed. */
+std::vector<std::string> split_words(const std::string &str)
+{
+    std::vector<std::string> words;
+    std::string::size_type i = 0;
+    while(i < str.length()) {
+        if(!is_word_char(str[i])) {
+            ++i;
+            continue;
+        }
+        std::string::size_type j = i;
+        while(j < str.length() && is_word_char(str[j]))
+            ++j;
+        words.push_back(str.substr(i, j-i));
+        i = j;
+    }
+    return words;
+}
+
+} // namespace
+
 WindowShareBrowser::WindowShareBrowser(User::Ptr user, const std::string &path):
+    m_user(user),
     m_listing(user),
-    m_path(path)
+    m_path(path),
+    m_dir(0),
+    m_loadState(LOAD_RUNNING),
+    m_loader(0)
 {
     m_insertMode = false;
-    set_title("Browsing user " + user->getFirstNick());
+    set_title("Loading the file list of " + user->getFirstNick() + "...");
     set_name("List:" + user->getFirstNick());
-    try {
-        m_listing.loadFile(path);
-        m_root = new display::Directory(0);
-        m_current = m_root;
 
-        create_tree(m_listing.getRoot(), m_root);
-        create_list();
+    m_bindings['/'] = std::bind(&WindowShareBrowser::set_search, this);
+
+    m_loader = new boost::thread(std::bind(&WindowShareBrowser::load, this));
+}
+
+void WindowShareBrowser::load()
+{
+    LoadState state = LOAD_FAILED;
+    try {
+        m_listing.loadFile(m_path);
+        index_names(m_listing.getRoot());
+        std::sort(m_index.begin(), m_index.end(), WordLess());
+        state = LOAD_DONE;
     } catch(Exception &e) {
-        core::Log::get()->log("Cannot open list '" + path + "'" +
-                                  " for user " + user->getFirstNick());
+        core::Log::get()->log("Cannot open list '" + m_path + "'" +
+                                  " for user " + m_user->getFirstNick() +
+                                  ": " + e.getError());
     }
+
+    {
+        utils::Lock lock(m_loadLock);
+        m_loadState = state;
+    }
+    events::emit("window updated", dynamic_cast<display::Window*>(this));
 }
 
-void WindowShareBrowser::create_tree(Dir *parent, display::Directory *parent2)
+void WindowShareBrowser::index_names(Dir *dir)
 {
-    display::Directory *current = new display::Directory(parent2);
-    parent2->get_children().push_back(current);
-    std::for_each(parent->directories.begin(), parent->directories.end(),
-            std::bind(&WindowShareBrowser::create_tree, this,
-                std::placeholders::_1, current));
-
-    for(File::List::iterator i = parent->files.begin(); i != parent->files.end(); ++i) {
-        current->append_child(new ShareItem(*i));
-        core::Log::get()->log((*i)->getName());
+    for(File::List::iterator i = dir->files.begin(); i != dir->files.end(); ++i) {
+        const std::string &name = (*i)->getName();
+        for(uint32_t j = 0; j < name.length(); ++j) {
+            if(is_word_char(name[j]) && (j == 0 || !is_word_char(name[j-1]))) {
+                Word word = { *i, j };
+                m_index.push_back(word);
+            }
+        }
     }
 
+    std::for_each(dir->directories.begin(), dir->directories.end(),
+            std::bind(&WindowShareBrowser::index_names, this,
+                std::placeholders::_1));
 }
 
-void WindowShareBrowser::create_list(/*display::Directory *parent*/)
+void WindowShareBrowser::redraw()
 {
-    /*set_title(m_current->getName());
+    if(!m_dir) {
+        LoadState state;
+        {
+            utils::Lock lock(m_loadLock);
+            state = m_loadState;
+        }
 
-    DirectoryListing::Directory dirs = m_current->directories;
-    for(Dir::Iter it = dirs.begin(); it != dirs.end(); it++) {
-        m_dirView->set_text(0, m_dirView->insert_row(), (*it)->getName());
+        if(state == LOAD_DONE) {
+            m_dir = m_listing.getRoot();
+            create_list();
+        }
+        else if(state == LOAD_FAILED) {
+            set_title("Cannot open the file list of " + m_user->getFirstNick());
+        }
     }
 
-    DirectoryListing::File files = m_current->files;
-    for(File::List::iterator i = files.begin(); i != files.end(); ++i) {
-        m_fileView->set_text(0, m_fileView->insert_row(), (*i)->getName());
-    }
-    m_windowupdated(this);*/
+    DirectoryWindow::redraw();
+}
+
+std::string WindowShareBrowser::get_path(Dir *dir)
+{
+    std::string path;
+    for(; dir->getParent(); dir = dir->getParent())
+        path = "/" + dir->getName() + path;
+    return path.empty() ? "/" : path;
 }
 
-#if 0
 void WindowShareBrowser::create_list()
 {
-/*    typedef DirectoryListing::Directory Dir;
-    typedef DirectoryListing::File File;
-    set_title(m_current->getName());
-    display::Directory *currentDir = new display::Directory(m_current);
+    m_query.clear();
+    m_matches.clear();
+    m_dirView->delete_all();
+    m_fileView->delete_all();
 
-    DirectoryListing::Directory dirs = m_current->directories;
-    for(Dir::Iter it = dirs.begin(); it != dirs.end(); it++) {
+    if(m_dir->getParent())
+        m_dirView->set_text(0, m_dirView->insert_row(), "..");
+
+    for(Dir::Iter it = m_dir->directories.begin(); it != m_dir->directories.end(); ++it)
         m_dirView->set_text(0, m_dirView->insert_row(), (*it)->getName());
+
+    for(File::Iter it = m_dir->files.begin(); it != m_dir->files.end(); ++it)
+        m_fileView->set_text(0, m_fileView->insert_row(), (*it)->getName());
+
+    set_title("Browsing user " + m_user->getFirstNick() + ": " + get_path(m_dir));
+}
+
+void WindowShareBrowser::open_item()
+{
+    if(!m_dir)
+        return;
+
+    if(m_selectedView == DIRECTORIES) {
+        int row = m_dirView->get_selected_row();
+        if(row < 0 || row >= static_cast<int>(m_dirView->get_size()))
+            return;
+
+        if(m_dir->getParent()) {
+            if(row == 0) {
+                m_dir = m_dir->getParent();
+                create_list();
+                return;
+            }
+            row--;
+        }
+        m_dir = m_dir->directories[row];
+        create_list();
     }
+    else if(!m_query.empty()) {
+        int row = m_fileView->get_selected_row();
+        if(row < 0 || row >= static_cast<int>(m_matches.size()))
+            return;
 
-    DirectoryListing::File files = m_current->files;
-    for(File::List::iterator i = files.begin(); i != files.end(); ++i) {
-        m_fileView->set_text(0, m_fileView->insert_row(), (*i)->getName());
+        m_dir = m_matches[row]->getParent();
+        create_list();
     }
-    m_windowupdated(this);*/
 }
 
+void WindowShareBrowser::set_search()
+{
+    if(!m_dir)
+        return;
+
+    m_insertMode = true;
+    m_prompt = "Search for (^G cancels):";
+}
+
+void WindowShareBrowser::handle_line(const std::string &line)
+{
+    /* DirectoryWindow leaves insert mode once the enter key reaches it */
+    if(line.empty())
+        create_list();
+    else
+        search(line);
+}
 
-void WindowShareBrowser::create_list(DirectoryListing::Directory::List dirs, display::Directory *parent)
+void WindowShareBrowser::search(const std::string &str)
 {
-    typedef DirectoryListing::Directory Dir;
-    typedef DirectoryListing::File File;
-    display::Directory *child = new display::Directory(parent);
+    std::string query = fold(str);
+    std::vector<std::string> words = split_words(query);
+    if(words.empty())
+        return;
 
-    for(Dir::Iter it = dirs.begin(); it != dirs.end(); it++) {
-        for(File::List::iterator i=(*it)->files.begin(); i != (*it)->files.end(); ++i) {
-            int row = m_fileView->insert_row();
-            m_fileView->set_text(0, row, (*i)->getName());
-            if(parent->get_parent() == 0) {
-                set_current(child);
-            }
-            child->append_child(new ShareItem(*i));
+    File::List candidates;
+    if(!m_query.empty() && query.compare(0, m_query.length(), m_query) == 0) {
+        /* the query was only extended, so the new matches
+         * are among the old ones */
+        candidates.swap(m_matches);
+    }
+    else {
+        /* the longest word has the fewest files in the index */
+        std::string longest;
+        for(unsigned int i = 0; i < words.size(); ++i) {
+            if(words[i].length() > longest.length())
+                longest = words[i];
         }
-        int row = m_dirView->insert_row();
-        m_dirView->set_text(0, row, (*it)->getName());
-        create_list((*it)->directories, child);
+
+        std::pair<NameIndex::iterator, NameIndex::iterator> range =
+            std::equal_range(m_index.begin(), m_index.end(), longest, WordLess());
+        for(NameIndex::iterator i = range.first; i != range.second; ++i)
+            candidates.push_back(i->file);
+
+        /* a file is in the index once for each matching word */
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        std::sort(candidates.begin(), candidates.end(), File::FileSort());
+    }
+
+    m_matches.clear();
+    for(File::Iter it = candidates.begin(); it != candidates.end(); ++it) {
+        std::string name = fold((*it)->getName());
+        unsigned int i = 0;
+        while(i < words.size() && has_word(name, words[i]))
+            ++i;
+        if(i == words.size())
+            m_matches.push_back(*it);
     }
-    m_windowupdated(this);
+
+    m_query = query;
+    m_fileView->delete_all();
+    for(File::Iter it = m_matches.begin(); it != m_matches.end(); ++it)
+        m_fileView->set_text(0, m_fileView->insert_row(), (*it)->getName());
+
+    set_title(utils::to_string(m_matches.size()) + " files matching '" + str + "'");
 }
 
-#endif
+WindowShareBrowser::~WindowShareBrowser()
+{
+    /* the listing can't be freed while it is being loaded */
+    m_loader->join();
+    delete m_loader;
+}
 
 } // namespace ui
@@ -25,43 +25,75 @@
 #ifndef _WINDOWSHAREBROWSER_H_
 #define _WINDOWSHAREBROWSER_H_
 
+#include <vector>
+#include <boost/thread/thread.hpp>
 #include <client/stdinc.h>
 #include <client/DCPlusPlus.h>
 #include <client/DirectoryListing.h>
 #include <display/directory_window.h>
+#include <utils/mutex.h>
 
 namespace ui {
 
 typedef DirectoryListing::Directory Dir;
 typedef DirectoryListing::File File;
 
+/** Browses a file list. The list is loaded in a thread of its own
+ * and the views show only the directory being browsed. */
 class WindowShareBrowser:
     public display::DirectoryWindow
 {
 public:
     WindowShareBrowser(User::Ptr user, const std::string &path);
 
-    //virtual void create_list(DirectoryListing::Directory::List dirs, display::Directory *parent);
+    /** Show the contents of the current directory. */
     virtual void create_list();
-    void create_tree(Dir *parent, display::Directory *parent2);
 
-    ~WindowShareBrowser() { }
+    /** Open the selected directory, or the directory of the
+     * selected search result. */
+    virtual void open_item();
+
+    /** Ask for a search string. */
+    void set_search();
+
+    /** Search the file names. */
+    void handle_line(const std::string &line);
+
+    /** Show the list once it is loaded. */
+    virtual void redraw();
+
+    ~WindowShareBrowser();
+
+    /** A word of a file name in the name index. */
+    struct Word {
+        File *file;
+        uint32_t offset; //!< Start of the word in the file name
+    };
+    typedef std::vector<Word> NameIndex;
 private:
+    enum LoadState { LOAD_RUNNING, LOAD_DONE, LOAD_FAILED };
+
+    /** Load the list and build the name index. Runs in m_loader. */
+    void load();
+    void index_names(Dir *dir);
+
+    /** Show the files with a word starting with each word of \c str. */
+    void search(const std::string &str);
+
+    std::string get_path(Dir *dir);
+
     User::Ptr m_user;
     DirectoryListing m_listing;
     std::string m_path;
-    class ShareItem:
-        public display::Item
-    {
-        public:
-            ShareItem(DirectoryListing::File *file):m_file(file){ }
-            std::string get_value() { return m_file->getName(); }
-            std::string get_line(unsigned int line) { return m_file->getTTH().toBase32(); }
-            ~ShareItem() { }
-        private:
-            DirectoryListing::File *m_file;
+    Dir *m_dir; //!< Directory being browsed, NULL until loaded
 
-    };
+    LoadState m_loadState; //!< Guarded by m_loadLock
+    utils::Mutex m_loadLock;
+    boost::thread *m_loader;
+
+    NameIndex m_index; //!< Sorted by the word
+    std::string m_query; //!< Last search, empty if not searching
+    File::List m_matches; //!< Files shown for m_query
 };
 
 } // namespace ui
@@ -369,7 +369,7 @@ WindowTransfers::~WindowTransfers()
     DownloadManager::getInstance()->removeListener(this);
     ConnectionManager::getInstance()->removeListener(this);
     UploadManager::getInstance()->removeListener(this);
-    TimerManager::getInstance()->removeListener(this);
+    TimerManager::getInstance()->removeListenerAndWait(this);
 }
 
 std::string WindowTransfers::get_infobox_line(unsigned int n)
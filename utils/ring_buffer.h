@@ -0,0 +1,99 @@
+/* vim:set ts=4 sw=4 sts=4 et cindent: */
+/*
+ * nanodc - The ncurses DC++ client
+ * Copyright © 2005-2006 Markus Lindqvist <nanodc.developer@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Contributor(s):
+ *
+ */
+
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <vector>
+#include <cstddef>
+
+namespace utils {
+
+/** A fixed-capacity sequence. Adding to a full buffer replaces
+ * the oldest item, so nothing needs to be moved. */
+template<typename T>
+class RingBuffer {
+public:
+    /** Constructor.
+     * @param capacity Maximum number of items, at least 1. */
+    RingBuffer(std::size_t capacity):
+        m_items(capacity > 0 ? capacity : 1),
+        m_first(0),
+        m_size(0)
+    {
+    }
+
+    /** Append an item, dropping the oldest one if the buffer is full.
+     * @return Reference to the stored item. */
+    T& push_back(const T &item) {
+        std::size_t n = index(m_size);
+        m_items[n] = item;
+        if(full())
+            m_first = index(1);
+        else
+            m_size++;
+        return m_items[n];
+    }
+
+    /** Get the nth item, 0 being the oldest. */
+    T& operator[](std::size_t n) { return m_items[index(n)]; }
+    const T& operator[](std::size_t n) const { return m_items[index(n)]; }
+
+    /** Get the newest item. */
+    T& back() { return (*this)[m_size-1]; }
+
+    std::size_t size() const { return m_size; }
+    std::size_t capacity() const { return m_items.size(); }
+    bool empty() const { return m_size == 0; }
+    bool full() const { return m_size == m_items.size(); }
+
+    /** Change the capacity, keeping the newest items. */
+    void set_capacity(std::size_t capacity) {
+        if(capacity < 1)
+            capacity = 1;
+        if(capacity == m_items.size())
+            return;
+
+        std::size_t keep = m_size < capacity ? m_size : capacity;
+        std::vector<T> items(capacity);
+        for(std::size_t i = 0; i < keep; ++i)
+            items[i] = (*this)[m_size - keep + i];
+
+        m_items.swap(items);
+        m_first = 0;
+        m_size = keep;
+    }
+private:
+    std::size_t index(std::size_t n) const {
+        n += m_first;
+        return n < m_items.size() ? n : n - m_items.size();
+    }
+
+    std::vector<T> m_items;
+    std::size_t m_first; //!< Position of the oldest item
+    std::size_t m_size;
+};
+
+} // namespace utils
+
+#endif // _RING_BUFFER_H_